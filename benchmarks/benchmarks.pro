@@ -0,0 +1,34 @@
+TEMPLATE = app
+TARGET = tst_bench_qtoolwindowmanager
+
+QT += widgets testlib
+CONFIG += testcase
+
+# the benchmarks use the private API, which isn't exported by the library,
+# so the library sources are built into the benchmark executable
+LIBDIR = ../libqtoolwindowmanager
+
+HEADERS += \
+    $$LIBDIR/qabstracttoolwindowmanagerarea.h \
+    $$LIBDIR/qtoolwindowmanager.h \
+    $$LIBDIR/qtoolwindowmanagerstate.h \
+    $$LIBDIR/private/qtoolwindowmanagerarea_p.h \
+    $$LIBDIR/private/qtoolwindowmanager_p.h \
+    $$LIBDIR/private/qtoolwindowmanageroverlay_p.h \
+    $$LIBDIR/private/qtoolwindowmanagerstate_p.h \
+    $$LIBDIR/private/qtoolwindowmanagertrace_p.h \
+    $$LIBDIR/private/qtoolwindowmanagerwrapper_p.h
+
+SOURCES += \
+    $$LIBDIR/qabstracttoolwindowmanagerarea.cpp \
+    $$LIBDIR/qtoolwindowmanager.cpp \
+    $$LIBDIR/qtoolwindowmanagerarea.cpp \
+    $$LIBDIR/qtoolwindowmanageroverlay.cpp \
+    $$LIBDIR/qtoolwindowmanagerstate.cpp \
+    $$LIBDIR/qtoolwindowmanagertrace.cpp \
+    $$LIBDIR/qtoolwindowmanagerwrapper.cpp \
+    tst_qtoolwindowmanager.cpp
+
+INCLUDEPATH += $$LIBDIR
+
+DEFINES += QTOOLWINDOWMANAGER_BUILD_LIB
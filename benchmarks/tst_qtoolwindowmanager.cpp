@@ -0,0 +1,512 @@
+/****************************************************************************
+**
+** Copyright (C) 2014 Pavel Strakhov <ri@idzaaus.org>
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+**
+** Copyright (C) 2014 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the examples of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Digia Plc and its Subsidiary(-ies) nor the names
+**     of its contributors may be used to endorse or promote products derived
+**     from this software without specific prior written permission.
+**
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QtWidgets>
+
+#include <cstdlib>
+#include <new>
+
+#include <qtoolwindowmanager.h>
+#include <private/qtoolwindowmanager_p.h>
+#include <private/qtoolwindowmanagerwrapper_p.h>
+
+// number of operator new calls since the start of the program
+static QBasicAtomicInt allocationCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void *operator new(std::size_t size)
+{
+    void *block = std::malloc(size ? size : 1);
+    if (!block)
+        throw std::bad_alloc();
+    allocationCount.ref();
+    return block;
+}
+
+void operator delete(void *block) Q_DECL_NOTHROW
+{
+    if (!block)
+        return;
+    std::free(block);
+}
+
+// Run with "-o results.csv,csv" or "-o results.xml,xml" to get machine-readable results.
+// Each benchmark has a row for 10, 100 and 1000 tool windows.
+class tst_QToolWindowManager : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void addToolWindows_data();
+    void addToolWindows();
+    void moveToolWindowsToArea_data();
+    void moveToolWindowsToArea();
+    void moveToolWindowsToReference_data();
+    void moveToolWindowsToReference();
+    void removeToolWindow_data();
+    void removeToolWindow();
+    void saveState_data();
+    void saveState();
+    void restoreState_data();
+    void restoreState();
+    void simplifyLayout_data();
+    void simplifyLayout();
+    void findSuggestions_data();
+    void findSuggestions();
+
+    void dragAllocations();
+
+private:
+    QToolWindowManager *m_manager;
+    QWidgetList m_toolWindows;
+
+    void addToolWindowCountRows();
+    void addFormatRows();
+    void createToolWindows(int count);
+    void buildLayout();
+    void flushEvents();
+    QPoint dragPosition() const;
+    bool startDrag(const QWidgetList &toolWindows);
+    void dragTo(const QPoint &pos);
+    bool waitForDragUpdate();
+};
+
+static const int toolWindowCounts[] = { 10, 100, 1000 };
+static const int toolWindowCountCount = sizeof(toolWindowCounts) / sizeof(toolWindowCounts[0]);
+
+static const char *enumKey(const char *enumName, int value)
+{
+    const QMetaObject &metaObject = QToolWindowManager::staticMetaObject;
+    return metaObject.enumerator(metaObject.indexOfEnumerator(enumName)).valueToKey(value);
+}
+
+void tst_QToolWindowManager::init()
+{
+    m_manager = new QToolWindowManager();
+    m_manager->resize(1200, 800);
+    m_manager->show();
+    QVERIFY(QTest::qWaitForWindowExposed(m_manager));
+}
+
+void tst_QToolWindowManager::cleanup()
+{
+    QToolWindowManagerPrivate *d = QToolWindowManagerPrivate::get(m_manager);
+    if (d->dragInProgress()) {
+        QTest::mouseRelease(m_manager->windowHandle(), Qt::LeftButton, Qt::NoModifier,
+                            dragPosition());
+        d->updateDragPosition();
+    }
+    // hidden tool windows aren't owned by the manager
+    QList<QPointer<QWidget> > toolWindows;
+    foreach (QWidget *toolWindow, m_toolWindows)
+        toolWindows << toolWindow;
+    delete m_manager;
+    foreach (QWidget *toolWindow, toolWindows)
+        delete toolWindow;
+    m_toolWindows.clear();
+    flushEvents();
+}
+
+void tst_QToolWindowManager::addToolWindowCountRows()
+{
+    QTest::addColumn<int>("toolWindowCount");
+    for (int i = 0; i < toolWindowCountCount; i++)
+        QTest::newRow(QByteArray::number(toolWindowCounts[i]).constData()) << toolWindowCounts[i];
+}
+
+void tst_QToolWindowManager::addFormatRows()
+{
+    QTest::addColumn<bool>("binary");
+    QTest::addColumn<int>("toolWindowCount");
+    for (int binary = 0; binary < 2; binary++) {
+        for (int i = 0; i < toolWindowCountCount; i++) {
+            QByteArray name = QByteArray(binary ? "QIODevice" : "QVariant") + '/' +
+                              QByteArray::number(toolWindowCounts[i]);
+            QTest::newRow(name.constData()) << bool(binary) << toolWindowCounts[i];
+        }
+    }
+}
+
+void tst_QToolWindowManager::createToolWindows(int count)
+{
+    for (int i = 0; i < count; i++) {
+        QLabel *label = new QLabel(QString::fromLatin1("tool%1").arg(i + 1));
+        label->setObjectName(label->text());
+        label->setWindowTitle(label->text());
+        m_toolWindows << label;
+    }
+}
+
+// groups of 4 tabs, placed alternately to the right and to the bottom of the previous group
+void tst_QToolWindowManager::buildLayout()
+{
+    m_manager->addToolWindow(m_toolWindows[0], QToolWindowManager::EmptySpaceArea);
+    for (int i = 1; i < m_toolWindows.count(); i++) {
+        QAbstractToolWindowManagerArea *area = m_manager->areaFor(m_toolWindows[i - 1]);
+        QToolWindowManager::ReferenceType reference = QToolWindowManager::ReferenceAddTo;
+        if (i % 4 == 0)
+            reference = (i / 4) % 2 ? QToolWindowManager::ReferenceRightOf :
+                                      QToolWindowManager::ReferenceBottomOf;
+        m_manager->addToolWindow(m_toolWindows[i], reference, area);
+    }
+}
+
+void tst_QToolWindowManager::flushEvents()
+{
+    QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+    QCoreApplication::processEvents();
+}
+
+// center of the area containing the first tool window, in manager coordinates
+QPoint tst_QToolWindowManager::dragPosition() const
+{
+    QWidget *area = m_manager->areaFor(m_toolWindows[0]);
+    return area->mapTo(m_manager, area->rect().center());
+}
+
+// presses the left button at dragPosition() and starts dragging toolWindows
+bool tst_QToolWindowManager::startDrag(const QWidgetList &toolWindows)
+{
+    QPoint pos = dragPosition();
+    QCursor::setPos(m_manager->mapToGlobal(pos));
+    QTest::mousePress(m_manager->windowHandle(), Qt::LeftButton, Qt::NoModifier, pos);
+    QToolWindowManagerPrivate *d = QToolWindowManagerPrivate::get(m_manager);
+    d->startDrag(toolWindows);
+    return d->dragInProgress();
+}
+
+// moves the cursor to pos, given in manager coordinates, and waits for the drag to follow it
+void tst_QToolWindowManager::dragTo(const QPoint &pos)
+{
+    QCursor::setPos(m_manager->mapToGlobal(pos));
+    QTest::mouseMove(m_manager->windowHandle(), pos);
+    QVERIFY(waitForDragUpdate());
+}
+
+// processes events until the drag position update scheduled by the last mouse move has run
+bool tst_QToolWindowManager::waitForDragUpdate()
+{
+    QToolWindowManagerPrivate *d = QToolWindowManagerPrivate::get(m_manager);
+    for (int i = 0; i < 100 && d->m_dragPositionDirty; i++)
+        QCoreApplication::processEvents();
+    return !d->m_dragPositionDirty;
+}
+
+void tst_QToolWindowManager::addToolWindows_data()
+{
+    addToolWindowCountRows();
+}
+
+// each iteration also removes the tool windows again
+void tst_QToolWindowManager::addToolWindows()
+{
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    QBENCHMARK {
+        m_manager->addToolWindows(m_toolWindows, QToolWindowManager::EmptySpaceArea);
+        foreach (QWidget *toolWindow, m_toolWindows)
+            m_manager->removeToolWindow(toolWindow);
+        flushEvents();
+    }
+}
+
+void tst_QToolWindowManager::moveToolWindowsToArea_data()
+{
+    // EmptySpaceArea is only valid for an empty manager
+    static const QToolWindowManager::AreaType areas[] = {
+        QToolWindowManager::LastUsedArea, QToolWindowManager::NewFloatingArea,
+        QToolWindowManager::NoArea
+    };
+    QTest::addColumn<int>("area");
+    QTest::addColumn<int>("toolWindowCount");
+    for (size_t a = 0; a < sizeof(areas) / sizeof(areas[0]); a++) {
+        for (int i = 0; i < toolWindowCountCount; i++) {
+            QByteArray name = QByteArray(enumKey("AreaType", areas[a])) + '/' +
+                              QByteArray::number(toolWindowCounts[i]);
+            QTest::newRow(name.constData()) << int(areas[a]) << toolWindowCounts[i];
+        }
+    }
+}
+
+// moves half of the tool windows; each iteration also moves them back to the first area
+void tst_QToolWindowManager::moveToolWindowsToArea()
+{
+    QFETCH(int, area);
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    QAbstractToolWindowManagerArea *home = m_manager->areaFor(m_toolWindows[0]);
+    QWidgetList movedToolWindows = m_toolWindows.mid(toolWindowCount / 2);
+    QBENCHMARK {
+        m_manager->moveToolWindows(movedToolWindows, static_cast<QToolWindowManager::AreaType>(area));
+        m_manager->moveToolWindows(movedToolWindows, QToolWindowManager::ReferenceAddTo, home);
+        flushEvents();
+    }
+}
+
+void tst_QToolWindowManager::moveToolWindowsToReference_data()
+{
+    QTest::addColumn<int>("reference");
+    QTest::addColumn<int>("toolWindowCount");
+    for (int reference = QToolWindowManager::ReferenceAddTo;
+         reference <= QToolWindowManager::ReferenceBottomOf; reference++) {
+        for (int i = 0; i < toolWindowCountCount; i++) {
+            QByteArray name = QByteArray(enumKey("ReferenceType", reference)) + '/' +
+                              QByteArray::number(toolWindowCounts[i]);
+            QTest::newRow(name.constData()) << reference << toolWindowCounts[i];
+        }
+    }
+}
+
+// shows half of the tool windows relative to the first area; each iteration also hides them again
+void tst_QToolWindowManager::moveToolWindowsToReference()
+{
+    QFETCH(int, reference);
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    QAbstractToolWindowManagerArea *home = m_manager->areaFor(m_toolWindows[0]);
+    QWidgetList movedToolWindows = m_toolWindows.mid(toolWindowCount / 2);
+    m_manager->moveToolWindows(movedToolWindows, QToolWindowManager::NoArea);
+    QBENCHMARK {
+        m_manager->moveToolWindows(movedToolWindows,
+                                   static_cast<QToolWindowManager::ReferenceType>(reference), home);
+        m_manager->moveToolWindows(movedToolWindows, QToolWindowManager::NoArea);
+        flushEvents();
+    }
+}
+
+void tst_QToolWindowManager::removeToolWindow_data()
+{
+    addToolWindowCountRows();
+}
+
+// each iteration also builds the layout again
+void tst_QToolWindowManager::removeToolWindow()
+{
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    QBENCHMARK {
+        buildLayout();
+        foreach (QWidget *toolWindow, m_toolWindows)
+            m_manager->removeToolWindow(toolWindow);
+        flushEvents();
+    }
+}
+
+void tst_QToolWindowManager::saveState_data()
+{
+    addFormatRows();
+}
+
+void tst_QToolWindowManager::saveState()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    if (binary) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QBENCHMARK {
+            buffer.seek(0);
+            m_manager->saveState(&buffer);
+        }
+    } else {
+        QBENCHMARK {
+            QVariant state = m_manager->saveState();
+        }
+    }
+}
+
+void tst_QToolWindowManager::restoreState_data()
+{
+    addFormatRows();
+}
+
+// each iteration also hides all tool windows before restoring the layout
+void tst_QToolWindowManager::restoreState()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    if (binary) {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(m_manager->saveState(&buffer));
+        QBENCHMARK {
+            m_manager->moveToolWindows(m_toolWindows, QToolWindowManager::NoArea);
+            buffer.seek(0);
+            m_manager->restoreState(&buffer);
+            flushEvents();
+        }
+    } else {
+        QVariant state = m_manager->saveState();
+        QBENCHMARK {
+            m_manager->moveToolWindows(m_toolWindows, QToolWindowManager::NoArea);
+            m_manager->restoreState(state);
+            flushEvents();
+        }
+    }
+}
+
+void tst_QToolWindowManager::simplifyLayout_data()
+{
+    addToolWindowCountRows();
+}
+
+// simplifyLayout is run when the outermost layout transaction is committed. Each iteration
+// hides every other group of tabs, which leaves splitters to be simplified, and then restores
+// the layout.
+void tst_QToolWindowManager::simplifyLayout()
+{
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    QVariant state = m_manager->saveState();
+    QWidgetList hiddenToolWindows;
+    for (int i = 0; i < m_toolWindows.count(); i++) {
+        if ((i / 4) % 2)
+            hiddenToolWindows << m_toolWindows[i];
+    }
+    QBENCHMARK {
+        m_manager->beginLayoutTransaction();
+        m_manager->moveToolWindows(hiddenToolWindows, QToolWindowManager::NoArea);
+        m_manager->commitLayoutTransaction();
+        m_manager->restoreState(state);
+        flushEvents();
+    }
+}
+
+void tst_QToolWindowManager::findSuggestions_data()
+{
+    addToolWindowCountRows();
+}
+
+// suggestions for the center of the first area while the last tool window is dragged
+void tst_QToolWindowManager::findSuggestions()
+{
+    QFETCH(int, toolWindowCount);
+    createToolWindows(toolWindowCount);
+    buildLayout();
+    QToolWindowManagerWrapper *wrapper = m_manager->findChild<QToolWindowManagerWrapper*>();
+    QVERIFY(wrapper);
+    QVERIFY(startDrag(QWidgetList() << m_toolWindows.last()));
+    QToolWindowManagerPrivate *d = QToolWindowManagerPrivate::get(m_manager);
+    QBENCHMARK {
+        d->findSuggestions(wrapper);
+    }
+    QVERIFY(!d->m_suggestions.isEmpty());
+}
+
+// The drag machinery reuses its buffers, so once every suggestion on the path has been shown,
+// further moves along the path must not leave any heap blocks behind.
+// Checks that mouse moves during a drag don't allocate once overlays are created and
+// caches are filled. Moves that change the drop suggestion repaint overlays, which
+// allocates inside Qt, so the measured moves keep the cursor in one place.
+void tst_QToolWindowManager::dragAllocations()
+{
+    createToolWindows(16);
+    buildLayout();
+    QVERIFY(startDrag(QWidgetList() << m_toolWindows.last()));
+    QToolWindowManagerPrivate *d = QToolWindowManagerPrivate::get(m_manager);
+    // moves are handled on the next event loop pass instead of the next display frame
+    d->m_dragUpdateTimer.setInterval(0);
+    // warm-up along a diagonal of the manager, crossing areas and splitters
+    const int pathLength = 100;
+    QRect rect = m_manager->rect();
+    for (int i = 0; i < pathLength; i++)
+        dragTo(QPoint(rect.left() + rect.width() * i / pathLength,
+                      rect.top() + rect.height() * i / pathLength));
+    QPoint pos = dragPosition();
+    dragTo(pos);
+    // QTest::mouseMove and posted events allocate inside Qt for every event, so the
+    // measured moves are sent directly; they reach the drag filter installed on the
+    // application the same way
+    QMouseEvent event(QEvent::MouseMove, pos, m_manager->mapToGlobal(pos),
+                      Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+    QApplication::sendEvent(m_manager, &event);
+    QVERIFY(waitForDragUpdate());
+    int allocationsBefore = allocationCount.load();
+    for (int step = 0; step < 1000; step++) {
+        QApplication::sendEvent(m_manager, &event);
+        QVERIFY(waitForDragUpdate());
+    }
+    int allocations = allocationCount.load() - allocationsBefore;
+    QCOMPARE(allocations, 0);
+    QVERIFY(d->dragInProgress());
+}
+
+int main(int argc, char *argv[])
+{
+    // the benchmarks don't need a display
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    tst_QToolWindowManager test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_qtoolwindowmanager.moc"
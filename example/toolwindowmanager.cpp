@@ -137,7 +137,10 @@ void ToolWindowManager::toolWindowVisibilityChanged(QWidget *toolWindow, bool vi
 void ToolWindowManager::on_actionSaveState_triggered()
 {
     QSettings settings;
-    settings.setValue("toolWindowManagerState", ui->toolWindowManager->saveState());
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    ui->toolWindowManager->saveState(&buffer);
+    settings.setValue("toolWindowManagerState", buffer.data());
     settings.setValue("geometry", saveGeometry());
 }
 
@@ -68,8 +68,15 @@
 #else
 #include <QtGui/qwidget.h>
 #endif
+#include <QtCore/qatomic.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qset.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qvector.h>
 #include <qtoolwindowmanager.h>
 #include <private/qtoolwindowmanagerarea_p.h>
+#include <private/qtoolwindowmanagerstate_p.h>
+#include <private/qtoolwindowmanagertrace_p.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -84,6 +91,12 @@ public:
     QToolWindowManager::ReferenceType referenceType() const { return m_referenceType; }
     bool isReference() const { return m_widget != 0; }
     QWidget *widget() const { return m_widget; }
+    bool operator==(const QToolWindowManagerAreaReference &other) const
+    {
+        return m_areaType == other.m_areaType && m_referenceType == other.m_referenceType &&
+               m_widget == other.m_widget;
+    }
+    bool operator!=(const QToolWindowManagerAreaReference &other) const { return !(*this == other); }
 
 private:
     QToolWindowManager::AreaType m_areaType;
@@ -96,6 +109,7 @@ class QTabWidget;
 class QTabBar;
 class QLabel;
 class QToolWindowManagerWrapper;
+class QToolWindowManagerOverlay;
 class QToolWindowManagerPrivate;
 
 class QToolWindowManagerPrivateSlots : public QObject {
@@ -106,6 +120,29 @@ public Q_SLOTS:
     void showNextDropSuggestion();
     //void tabCloseRequested(int index);
     void areaDestroyed(QObject *object);
+    void splitterDestroyed(QObject *object);
+    void updateDragPosition();
+    void createPendingToolWindows();
+    void updateExposure();
+    void updateToolWindowsMetadata();
+    void toolWindowMetadataChanged();
+    void toolWindowNameChanged();
+    void autoSave();
+    void scheduleAutoSave();
+    void splitterMoved();
+
+protected:
+    // installed on placeholders, on splitters, on the window containing the manager
+    // and, with Qt older than 5.2, on tool windows
+    bool eventFilter(QObject *object, QEvent *event);
+};
+
+// installed on the application while a drag is in progress
+class QToolWindowManagerDragFilter : public QObject {
+public:
+    QToolWindowManagerPrivate* d;
+protected:
+    bool eventFilter(QObject *object, QEvent *event);
 };
 
 
@@ -113,6 +150,29 @@ class QToolWindowManagerPrivate
 {
     Q_DECLARE_PUBLIC(QToolWindowManager)
 public:
+    // gives benchmarks and tests access to the private API
+    static QToolWindowManagerPrivate *get(QToolWindowManager *manager) { return manager->d_func(); }
+
+    // record of an added tool window; defined first because member functions below use it
+    struct ToolWindowData {
+      ToolWindowData() : index(-1), area(0), leftButtonWidget(0), rightButtonWidget(0),
+                         exposure(QToolWindowManager::ToolWindowHidden) {}
+      // position of the tool window in m_toolWindows
+      int index;
+      // object name the tool window is indexed by in m_toolWindowsByName
+      QString name;
+      // area containing the tool window, or 0 if it is hidden
+      QAbstractToolWindowManagerArea *area;
+      QWidget *leftButtonWidget;
+      QWidget *rightButtonWidget;
+      // factory of a tool window that hasn't been created yet
+      // (the record then belongs to the placeholder widget)
+      QPointer<QObject> factoryReceiver;
+      QByteArray factoryMethod;
+      // last exposure state reported by toolWindowExposureChanged
+      QToolWindowManager::ExposureState exposure;
+    };
+
     void addToolWindows(QList<QWidget*> toolWindows, const QToolWindowManagerAreaReference& area);
     void moveToolWindows(const QWidgetList &toolWindows, const QToolWindowManagerAreaReference& area);
 
@@ -125,16 +185,27 @@ public:
     int m_borderSensitivity;
     int m_rubberBandLineWidth;
     bool m_tabsClosable;
+    int m_dragPixmapTabLimit;
     // list of tool windows that are currently dragged, or empty list if there is no current drag
     QList<QWidget *> m_draggedToolWindows;
     // label used to display dragged content
     QLabel *m_dragIndicator;
 
-    // placeholder objects used for displaying drop suggestions
+    // never shown; provide style for drop suggestions painted by overlays
     QRubberBand *m_rectRubberBand;
     QRubberBand *m_lineRubberBand;
+    // overlays created for the manager and floating windows
+    QList<QPointer<QToolWindowManagerOverlay> > m_overlays;
+    // overlay displaying current drop suggestion
+    QPointer<QToolWindowManagerOverlay> m_activeOverlay;
+    QToolWindowManagerOverlay *overlayFor(QWidget *parent);
+    void showSuggestion(QRubberBand *rubberBand, QWidget *parent, const QRect &geometry);
+    void hideOverlays();
     // full list of suggestions for current cursor position
-    QList<QToolWindowManagerAreaReference> m_suggestions;
+    QVector<QToolWindowManagerAreaReference> m_suggestions;
+    // scratch buffer for computing suggestions, swapped with m_suggestions
+    // to avoid memory allocation while dragging
+    QVector<QToolWindowManagerAreaReference> m_suggestionBuffer;
     // index of currently displayed drop suggestion
     // (e.g. always 0 if there is only one possible drop location)
     int m_dropCurrentSuggestionIndex;
@@ -144,40 +215,228 @@ public:
     // (warning: may contain pointer to deleted object)
     QAbstractToolWindowManagerArea *m_lastUsedArea;
     void handleNoSuggestions();
+    // replace current suggestions by contents of m_suggestionBuffer;
+    // keeps displayed suggestion and timer if nothing has changed
+    void applySuggestionBuffer();
+
+    // nesting depth of layout transactions (0 if there is no transaction in progress)
+    int m_transactionDepth;
+    // widgets that have updates disabled until the outermost transaction is committed
+    QList<QPointer<QWidget> > m_suspendedWidgets;
+    // tool windows that need toolWindowVisibilityChanged emitted on commit
+    QList<QPointer<QWidget> > m_changedToolWindows;
+    QSet<QWidget *> m_changedToolWindowsSet;
+    // floating wrappers created during the transaction that should be shown on commit
+    QList<QPointer<QToolWindowManagerWrapper> > m_wrappersToShow;
+    void beginTransaction();
+    void commitTransaction();
+    void suspendUpdates(QWidget *widget);
+    void toolWindowChanged(QWidget *toolWindow);
+    void showWrapper(QToolWindowManagerWrapper *wrapper);
+
     // remove tool window from its area (if any) and set parent to 0
     void releaseToolWindow(QWidget *toolWindow);
-    // remove constructions that became useless
+    // remove constructions that became useless in branches of dirty areas
     void simplifyLayout();
+    // areas that have been changed since the last simplifyLayout
+    QList<QPointer<QAbstractToolWindowManagerArea> > m_dirtyAreas;
+    void markDirty(QAbstractToolWindowManagerArea *area);
+    // Autosave: layout changes restart the timer, then a snapshot of the layout is taken
+    // and written to the file by a worker thread. Jobs run one at a time in m_autoSavePool.
+    QString m_autoSaveFileName;
+    QTimer m_autoSaveTimer;
+    bool m_autoSaveDirty;
+    QThreadPool m_autoSavePool;
+    // 1 if the last autosave job failed
+    QAtomicInt m_autoSaveFailed;
+    void scheduleAutoSave();
+    void autoSave();
+
+    // splitters whose branches may contain splitters with a single item or nested splitters
+    // of the same orientation
+    QList<QPointer<QSplitter> > m_dirtySplitters;
+    void markDirty(QSplitter *splitter);
+    // merge such splitters into their parents in trees of dirty splitters
+    void normalizeLayout();
+    void normalizeSplitter(QSplitter *splitter);
     void startDrag(const QWidgetList &toolWindows);
 
     QVariantMap saveAreaState(QAbstractToolWindowManagerArea *area);
-    QAbstractToolWindowManagerArea *restoreAreaState(const QVariantMap& data);
-
     QVariantMap saveSplitterState(QSplitter *splitter);
-    QSplitter *restoreSplitterState(const QVariantMap& data);
+    // Saved state of areas and splitters that haven't changed since it was saved.
+    // A splitter is cached only if all its items are cached, so a change of a widget
+    // invalidates the widget and its parent splitters.
+    QHash<QWidget*, QVariantMap> m_savedStateCache;
+    // the same for the state used by the binary format and autosave
+    mutable QHash<QWidget*, QToolWindowManagerStateNode> m_capturedStateCache;
+    // invalidates both caches
+    void invalidateSavedState(QWidget *widget);
+
+    bool writeState(QIODevice *device) const;
+    // describe the current layout
+    void captureState(QToolWindowManagerStateData &state) const;
+    void captureWindowState(QToolWindowManagerWrapper *wrapper,
+                            QToolWindowManagerStateWindow &window) const;
+    void captureNodeState(QWidget *widget, QToolWindowManagerStateNode &node) const;
+    // change the current layout to the given one, reusing areas and splitters when possible
+    void restoreState(const QToolWindowManagerStateData &state);
+    // detached empty areas and splitters kept for reuse (children of the manager)
+    int m_recyclePoolSize;
+    QList<QPointer<QAbstractToolWindowManagerArea> > m_areaPool;
+    QList<QPointer<QSplitter> > m_splitterPool;
+    // hidden floating wrappers; they are not listed in m_wrappers
+    QList<QPointer<QToolWindowManagerWrapper> > m_wrapperPool;
+    // remove an empty area or a splitter (and its child splitters) from the layout
+    // and put it to the pool or delete it
+    void disposeArea(QAbstractToolWindowManagerArea *area);
+    void disposeSplitter(QSplitter *splitter);
+    // hide an empty floating wrapper and put it to the pool or delete it
+    void disposeWrapper(QToolWindowManagerWrapper *wrapper);
+    QToolWindowManagerWrapper *createFloatingWrapper();
+
+    // objects removed with deleteLater that haven't been deleted yet
+    QList<QPointer<QObject> > m_pendingDeletions;
+    void scheduleDeletion(QObject *object);
+    // collect splitters and areas of the layout tree under widget; returns depth of splitters
+    int collectLayout(QWidget *widget, QSet<QWidget*> &reachable) const;
+    // areas and splitters created by the manager that are neither deleted
+    // nor scheduled for deletion, whether or not they are in the layout
+    QSet<QWidget*> m_layoutWidgets;
+    // items of m_layoutWidgets that are not reachable from any wrapper and are not pooled
+    QWidgetList unreachableWidgets(const QSet<QWidget*> &reachable) const;
+    // warn about unreachable widgets (debug builds only)
+    void checkLayout() const;
+    void recycle(QWidget *widget);
+
+    // tool windows with changed title, icon or tool tip, reported to areas once per frame
+    QList<QPointer<QWidget> > m_metadataChangedToolWindows;
+    QSet<QWidget*> m_metadataChangedToolWindowsSet;
+    QTimer m_metadataUpdateTimer;
+    void toolWindowMetadataChanged(QWidget *toolWindow);
+    void updateToolWindowsMetadata();
+
+    // exposure of tool windows is recomputed once after a batch of changes
+    QTimer m_exposureUpdateTimer;
+    // the window containing the manager; its state changes affect exposure
+    QPointer<QWidget> m_exposureWindow;
+    // tool windows, areas, and wrappers or widgets containing them, whose tool windows
+    // need their exposure recomputed
+    QList<QPointer<QWidget> > m_exposureChangedWidgets;
+    QSet<QWidget*> m_exposureChangedWidgetsSet;
+    void scheduleExposureUpdate(QWidget *widget);
+    void updateExposure();
+    QToolWindowManager::ExposureState computeExposure(QWidget *toolWindow,
+                                                      const ToolWindowData &data) const;
+
+    // spans of layout operations, recorded only when tracing is enabled
+    mutable QToolWindowManagerTrace m_trace;
+
+    // areas and splitters that are part of the layout being restored
+    QSet<QWidget*> m_restoredWidgets;
+    // true while a saved layout is being applied
+    bool m_restoringState;
+    // saved sizes of restored splitters, parents before their children; sizes are applied
+    // as proportions of actual splitter sizes once the whole layout is built and the wrapper
+    // containing the splitter is visible
+    QList<QPair<QPointer<QSplitter>, QList<int> > > m_pendingSplitterSizes;
+    // applies and removes pending sizes of splitters in visible wrappers
+    void applySplitterSizes();
+    // returns an area, a splitter or 0 for an empty node;
+    // previous is the widget at the same place in the current layout
+    QWidget *restoreNodeState(const QToolWindowManagerStateNode &node, QWidget *previous);
+    QAbstractToolWindowManagerArea *restoreAreaState(const QToolWindowManagerStateNode &node);
+    QSplitter *restoreSplitterState(const QToolWindowManagerStateNode &node, QWidget *previous);
     void findSuggestions(QToolWindowManagerWrapper *wrapper);
+
+    // drop target candidate snapshotted at drag start;
+    // all rects are relative to the top level widget of the candidate
+    struct DropTarget {
+        enum { SideCount = 4 };
+        QWidget *widget;
+        bool isArea;
+        QRect rect;
+        // sensitive areas of the sides listed in dropTargetSides (null rect if side is not allowed)
+        QRect sideRects[SideCount];
+    };
+    struct DropWrapper {
+        QToolWindowManagerWrapper *wrapper;
+        QWidget *topLevel;
+        QRect rect;
+        // range of the wrapper's candidates in m_dropTargets
+        int firstTarget;
+        int targetCount;
+        // global geometry of the wrapper and position of its top level in m_topLevelOrder
+        QRect globalRect;
+        int zOrder;
+    };
+    // sorted from the topmost wrapper to the bottommost one
+    QVector<DropWrapper> m_dropWrappers;
+    QVector<DropTarget> m_dropTargets;
+    // false if the layout or wrapper geometry has changed since drop targets were built
+    bool m_dropTargetsValid;
+    // false if a top level has been moved or activated since global geometry was computed
+    bool m_dropWrapperGeometryValid;
+    void buildDropTargets();
+    void updateDropWrapperGeometry();
+    void invalidateDropTargets() { m_dropTargetsValid = false; }
+    void invalidateDropWrapperGeometry() { m_dropWrapperGeometryValid = false; }
+    // floating wrappers, most recently activated first
+    QList<QPointer<QWidget> > m_topLevelOrder;
+    void topLevelActivated(QWidget *topLevel);
+
     QRect sideSensitiveArea(QWidget *widget, QToolWindowManager::ReferenceType side);
     QRect sidePlaceHolderRect(QWidget *widget, QToolWindowManager::ReferenceType side);
 
     QSplitter *createAndSetupSplitter();
 
+    // coalesces drag position updates to at most one per display frame;
+    // runs while a drag is in progress and updates the position if the mouse has moved
+    QTimer m_dragUpdateTimer;
+    bool m_dragPositionDirty;
+    void scheduleDragPositionUpdate();
     void updateDragPosition();
     void finishDrag();
     bool dragInProgress() { return !m_draggedToolWindows.isEmpty(); }
 
     QToolWindowManagerPrivateSlots slots_object;
+    QToolWindowManagerDragFilter m_dragFilter;
     void showNextDropSuggestion();
     //void tabCloseRequested(int index, QObject *sender);
 
     QAbstractToolWindowManagerArea * createAndSetupArea();
 
-    struct ToolWindowData {
-      ToolWindowData() : leftButtonWidget(0), rightButtonWidget(0) {}
-      QWidget *leftButtonWidget;
-      QWidget *rightButtonWidget;
-    };
-
+    // records of all added tool windows (a tool window is added iff it has a record)
     QHash<QWidget *, ToolWindowData> m_toolWindowData;
+    // added tool windows indexed by object name
+    // (a name shared by several tool windows has several entries)
+    QMultiHash<QString, QWidget *> m_toolWindowsByName;
+
+    // returns the record of the tool window, or 0 if it hasn't been added
+    ToolWindowData *toolWindowData(QWidget *toolWindow);
+    const ToolWindowData *toolWindowData(QWidget *toolWindow) const;
+    // returns the added tool window with given object name, or 0 if there isn't one
+    QWidget *toolWindowByName(const QString &name);
+    // install the event filter on the tool window and connect to its change signals, or undo it
+    void trackToolWindow(QWidget *toolWindow);
+    void untrackToolWindow(QWidget *toolWindow);
+    // add or remove the entry of the tool window in m_toolWindowsByName
+    void indexToolWindowName(QWidget *toolWindow, const QString &name);
+    void unindexToolWindowName(QWidget *toolWindow, const QString &name);
+    // removes the record of the tool window, swapping the last tool window into its place
+    void forgetToolWindow(QWidget *toolWindow);
+    // updates m_toolWindowsByName after the object name of the tool window has changed
+    void toolWindowNameChanged(QWidget *toolWindow);
+#if QT_VERSION < 0x050000
+    void rebuildToolWindowNames();
+#endif
+    // add tool windows to the area and remember it as their owner
+    void addToolWindowsToArea(QAbstractToolWindowManagerArea *area, const QWidgetList &toolWindows);
+
+    // placeholders that have been shown and should be replaced by created tool windows
+    QList<QPointer<QWidget> > m_pendingPlaceholders;
+    void placeholderShown(QWidget *placeholder);
+    QWidget *createToolWindow(QWidget *placeholder);
+    void replaceToolWindow(QWidget *placeholder, QWidget *toolWindow);
 
     QToolWindowManager *q_ptr;
 
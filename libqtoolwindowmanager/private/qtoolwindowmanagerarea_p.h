@@ -91,6 +91,8 @@ public:
 protected:
     void addToolWindows(const QWidgetList &toolWindows);
     void removeToolWindow(QWidget *toolWindow);
+    void replaceToolWindow(QWidget *oldToolWindow, QWidget *newToolWindow);
+    void toolWindowsChanged(const QWidgetList &toolWindows);
     QVariant saveState() const;
     void restoreState(const QVariant &state);
     void beforeTabButtonChanged(QWidget *toolWindow);
@@ -115,6 +117,8 @@ private:
 
 private slots:
     void managerTabsClosableChanged(bool enabled);
+    void tabWidgetCurrentChanged();
+    void tabBarTabMoved();
 };
 
 #endif // QT_NO_TOOLWINDOWMANAGER
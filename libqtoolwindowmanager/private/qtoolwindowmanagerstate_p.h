@@ -0,0 +1,146 @@
+/****************************************************************************
+**
+** Copyright (C) 2014 Pavel Strakhov <ri@idzaaus.org>
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+**
+** Copyright (C) 2014 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtWidgets module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QTOOLWINDOWMANAGERSTATE_P_H
+#define QTOOLWINDOWMANAGERSTATE_P_H
+
+#include <QtGlobal>
+#include <QtCore/qlist.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvariant.h>
+
+QT_BEGIN_NAMESPACE
+
+#ifndef QT_NO_TOOLWINDOWMANAGER
+
+class QIODevice;
+
+// Layout description read from a saved state of any format.
+struct QToolWindowManagerStateNode
+{
+    enum Type { Empty, Area, Splitter };
+    QToolWindowManagerStateNode() : type(Empty), orientation(Qt::Horizontal) {}
+    Type type;
+    // area
+    QStringList objectNames;
+    QVariant customData;
+    // splitter
+    Qt::Orientation orientation;
+    QList<int> sizes;
+    QList<QToolWindowManagerStateNode> items;
+
+    bool operator==(const QToolWindowManagerStateNode &other) const
+    {
+        return type == other.type && objectNames == other.objectNames &&
+               customData == other.customData && orientation == other.orientation &&
+               sizes == other.sizes && items == other.items;
+    }
+};
+
+struct QToolWindowManagerStateWindow
+{
+    QByteArray geometry;
+    QToolWindowManagerStateNode root;
+
+    bool operator==(const QToolWindowManagerStateWindow &other) const
+    {
+        return geometry == other.geometry && root == other.root;
+    }
+};
+
+struct QToolWindowManagerStateData
+{
+    QToolWindowManagerStateWindow mainWrapper;
+    QList<QToolWindowManagerStateWindow> floatingWindows;
+
+    bool operator==(const QToolWindowManagerStateData &other) const
+    {
+        return mainWrapper == other.mainWrapper && floatingWindows == other.floatingWindows;
+    }
+};
+
+// Parsing and validation only work with data, so they may run in any thread.
+// Widgets are created from the parsed layout by QToolWindowManagerPrivate::restoreState.
+class QToolWindowManagerStatePrivate : public QSharedData
+{
+public:
+    QToolWindowManagerStatePrivate() : valid(false) {}
+
+    QToolWindowManagerStateData data;
+    bool valid;
+    QString errorString;
+
+    // format 1 (QVariant) and format 2 (binary) are read into the same layout description;
+    // false is returned and error is set if the data is malformed
+    static bool parse(const QVariantMap &variant, QToolWindowManagerStateData &state, QString *error);
+    static bool read(QIODevice *device, QToolWindowManagerStateData &state, QString *error);
+    static bool write(QIODevice *device, const QToolWindowManagerStateData &state);
+    // checks constraints that can't be checked while parsing, e.g. that each tool window
+    // is mentioned only once
+    static bool validate(const QToolWindowManagerStateData &state, QString *error);
+};
+
+#endif // QT_NO_TOOLWINDOWMANAGER
+
+QT_END_NAMESPACE
+
+#endif // QTOOLWINDOWMANAGERSTATE_P_H
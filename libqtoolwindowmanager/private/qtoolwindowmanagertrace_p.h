@@ -0,0 +1,160 @@
+/****************************************************************************
+**
+** Copyright (C) 2014 Pavel Strakhov <ri@idzaaus.org>
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+**
+** Copyright (C) 2014 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtWidgets module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QTOOLWINDOWMANAGERTRACE_P_H
+#define QTOOLWINDOWMANAGERTRACE_P_H
+
+#include <QtGlobal>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qvector.h>
+#if QT_VERSION >= 0x050400
+#include <QtCore/qloggingcategory.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+#ifndef QT_NO_TOOLWINDOWMANAGER
+
+class QIODevice;
+
+#if QT_VERSION >= 0x050400
+Q_DECLARE_LOGGING_CATEGORY(lcToolWindowManagerTrace)
+#else
+extern bool qt_toolwindowmanager_trace_enabled;
+#endif
+
+/*!
+ * The QToolWindowManagerTrace class records timed spans of QToolWindowManager operations.
+ * Recording is enabled by the "qt.toolwindowmanager.trace" logging category (or by
+ * the QT_TOOLWINDOWMANAGER_TRACE environment variable before Qt 5.4).
+ */
+class QToolWindowManagerTrace
+{
+public:
+    QToolWindowManagerTrace();
+
+    static bool isEnabled()
+    {
+#if QT_VERSION >= 0x050400
+        return lcToolWindowManagerTrace().isDebugEnabled();
+#else
+        return qt_toolwindowmanager_trace_enabled;
+#endif
+    }
+
+    void begin() { m_depth++; }
+    void end(const char *name, qint64 start, int widgetCount);
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+
+    // write recorded spans as Chrome trace event JSON
+    bool write(QIODevice *device) const;
+    void clear() { m_events.clear(); }
+    qint64 byteSize() const { return qint64(m_events.capacity()) * sizeof(Event); }
+
+private:
+    struct Event {
+        const char *name;
+        qint64 start;
+        qint64 duration;
+        int depth;
+        int widgetCount;
+    };
+    // the oldest spans are dropped when the limit is reached
+    enum { MaxEvents = 100000 };
+    QElapsedTimer m_clock;
+    QVector<Event> m_events;
+    int m_depth;
+};
+
+// Records a span from construction to destruction if tracing is enabled.
+class QToolWindowManagerTraceScope
+{
+public:
+    QToolWindowManagerTraceScope(QToolWindowManagerTrace *trace, const char *name, int widgetCount)
+        : m_trace(0)
+    {
+        if (QToolWindowManagerTrace::isEnabled()) {
+            m_trace = trace;
+            m_name = name;
+            m_widgetCount = widgetCount;
+            m_trace->begin();
+            m_start = m_trace->now();
+        }
+    }
+    ~QToolWindowManagerTraceScope()
+    {
+        if (m_trace)
+            m_trace->end(m_name, m_start, m_widgetCount);
+    }
+
+private:
+    Q_DISABLE_COPY(QToolWindowManagerTraceScope)
+    QToolWindowManagerTrace *m_trace;
+    const char *m_name;
+    int m_widgetCount;
+    qint64 m_start;
+};
+
+#endif // QT_NO_TOOLWINDOWMANAGER
+
+QT_END_NAMESPACE
+
+#endif // QTOOLWINDOWMANAGERTRACE_P_H
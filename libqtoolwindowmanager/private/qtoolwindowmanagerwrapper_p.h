@@ -77,6 +77,7 @@ QT_BEGIN_NAMESPACE
 #ifndef QT_NO_TOOLWINDOWMANAGER
 
 class QToolWindowManager;
+struct QToolWindowManagerStateWindow;
 
 /*!
  * The ToolWindowManagerWrapper class is used by ToolWindowManager to wrap its content.
@@ -94,6 +95,15 @@ public:
 protected:
     // Reimplemented to register hiding of contained tool windows when user closes the floating window.
     void closeEvent(QCloseEvent *) Q_DECL_OVERRIDE;
+    // Reimplemented to invalidate drop targets snapshotted by the manager
+    // and to autosave geometry of floating windows.
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+    void moveEvent(QMoveEvent *event) Q_DECL_OVERRIDE;
+    // Reimplemented to update exposure of contained tool windows
+    // and to track stacking order of floating windows.
+    void showEvent(QShowEvent *event) Q_DECL_OVERRIDE;
+    void hideEvent(QHideEvent *event) Q_DECL_OVERRIDE;
+    void changeEvent(QEvent *event) Q_DECL_OVERRIDE;
 
 private:
     Q_DISABLE_COPY(QToolWindowManagerWrapper)
@@ -102,8 +112,11 @@ private:
     //dump content's layout to variable
     QVariantMap saveState() const;
 
-    //construct layout based on given dump
-    void restoreState(const QVariantMap& data);
+    //construct layout based on given dump, reusing current content when possible
+    void restoreState(const QToolWindowManagerStateWindow &data);
+
+    //area or splitter contained in the wrapper
+    QWidget *content() const;
 
     friend class QToolWindowManager;
 };
@@ -150,6 +150,31 @@ void QAbstractToolWindowManagerArea::restoreState(const QVariant &state)
     Q_UNUSED(state);
 }
 
+/*!
+ * This virtual function is called when the manager replaces \a oldToolWindow, which is
+ * a member of the area, by \a newToolWindow (e.g. when a tool window registered with
+ * QToolWindowManager::addToolWindowFactory is created). Ownership and visibility
+ * of \a oldToolWindow should not be changed. Default implementation removes \a oldToolWindow
+ * and adds \a newToolWindow to the end of the list. Reimplement this function to keep
+ * the position of the tool window.
+ */
+void QAbstractToolWindowManagerArea::replaceToolWindow(QWidget *oldToolWindow, QWidget *newToolWindow)
+{
+    removeToolWindow(oldToolWindow);
+    addToolWindows(QWidgetList() << newToolWindow);
+}
+
+/*!
+ * This virtual function is called when window title, window icon or tool tip of
+ * \a toolWindows, which are members of the area, have been changed. Changes are collected
+ * by the manager and reported at most once per display frame. Default implementation
+ * does nothing.
+ */
+void QAbstractToolWindowManagerArea::toolWindowsChanged(const QWidgetList &toolWindows)
+{
+    Q_UNUSED(toolWindows);
+}
+
 void QAbstractToolWindowManagerArea::beforeTabButtonChanged(QWidget* toolWindow)
 {
   Q_UNUSED(toolWindow);
@@ -161,16 +186,28 @@ void QAbstractToolWindowManagerArea::tabButtonChanged(QWidget* toolWindow)
 }
 
 /*!
- * When user starts dragging tool windows from the area, it continues to receive mouse events
- * even if the mouse pointer leaves its boundaries. Call this function on every mouse move or
- * release event to update manager's state according to new mouse state.
+ * Requests the manager to update its drag state according to the current mouse state.
  *
- * TODO: we should try to implement this internally using event filters.
+ * The manager tracks mouse events of the whole application while a drag is in progress
+ * and updates drop suggestions at most once per display frame, so calling this function
+ * is not required. It only schedules such an update.
  */
 void QAbstractToolWindowManagerArea::updateDragPosition()
 {
     QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
-    manager_d->updateDragPosition();
+    manager_d->scheduleDragPositionUpdate();
+}
+
+/*!
+ * Call this function to notify the manager that visibility of tool windows inside the area
+ * may have changed without adding or removing them, e.g. when the current tab has been
+ * changed. The manager updates QToolWindowManager::toolWindowExposure of tool windows in
+ * the area later, so it's cheap to call this function several times in a row.
+ */
+void QAbstractToolWindowManagerArea::updateToolWindowExposure()
+{
+    QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
+    manager_d->scheduleExposureUpdate(this);
 }
 
 /*!
@@ -89,6 +89,8 @@ public:
 protected:
     virtual void addToolWindows(const QWidgetList &toolWindows) = 0;
     virtual void removeToolWindow(QWidget *toolWindow) = 0;
+    virtual void replaceToolWindow(QWidget *oldToolWindow, QWidget *newToolWindow);
+    virtual void toolWindowsChanged(const QWidgetList &toolWindows);
     virtual QVariant saveState() const;
     virtual void restoreState(const QVariant &state);    
     virtual void beforeTabButtonChanged(QWidget *toolWindow);
@@ -97,6 +99,7 @@ protected:
 
     void updateDragPosition();
     void startDrag(const QWidgetList &toolWindows);
+    void updateToolWindowExposure();
 
     QToolWindowManager *m_manager;
     friend class QToolWindowManager;
@@ -60,6 +60,7 @@
 ****************************************************************************/
 
 #include <qtoolwindowmanager.h>
+#include <qtoolwindowmanagerstate.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -76,8 +77,21 @@ QT_BEGIN_NAMESPACE
 #include <qevent.h>
 #include <qpainter.h>
 #include <qrubberband.h>
+#include <qpixmapcache.h>
+#include <qmetaobject.h>
+#include <qrunnable.h>
+#if QT_VERSION >= 0x050100
+#include <qsavefile.h>
+#else
+#include <qfile.h>
+#endif
+#if QT_VERSION >= 0x050000
+#include <qscreen.h>
+#endif
 #include <private/qtoolwindowmanagerarea_p.h>
 #include <private/qtoolwindowmanagerwrapper_p.h>
+#include <private/qtoolwindowmanageroverlay_p.h>
+#include <private/qtoolwindowmanagertrace_p.h>
 #include <private/qtoolwindowmanager_p.h>
 
 template<class T>
@@ -155,6 +169,54 @@ T findClosestParent(QWidget *widget)
 
     Default value is the same as QSplitter::handleWidth default value on current platform.
 */
+/*!
+    \property QToolWindowManager::dragPixmapTabLimit
+    \brief Maximal number of tabs drawn by the default implementation of
+    QToolWindowManager::generateDragPixmap.
+
+    When more tool windows are dragged at once, the remaining ones are represented by
+    a single tab showing their count. This keeps the time needed to start a drag bounded.
+    Zero or negative value means no limit.
+
+    Default value is 10.
+*/
+/*!
+    \property QToolWindowManager::autoSaveFileName
+    \brief Name of the file the layout is saved to automatically, or an empty string
+    if autosave is disabled.
+
+    When autosave is enabled, changes of the layout (moving tool windows, resizing
+    splitters and floating windows, switching tabs) are collected for
+    QToolWindowManager::autoSaveInterval milliseconds. Then the state is captured in
+    the GUI thread, and encoded and written to the file in a worker thread in the format
+    of QToolWindowManager::saveState(QIODevice*). The file is replaced atomically (since
+    Qt 5.1), so it always contains a complete state. Call QToolWindowManager::flushAutoSave
+    to write pending changes immediately, e.g. before the application exits.
+
+    Default value is an empty string.
+*/
+/*!
+    \property QToolWindowManager::autoSaveInterval
+    \brief Time in milliseconds between the last change of the layout and saving it
+    when autosave is enabled.
+
+    Default value is 1000.
+*/
+/*!
+    \property QToolWindowManager::recyclePoolSize
+    \brief Maximal number of areas, splitters and floating windows of each kind
+    that are kept for reuse after they are removed from the layout.
+
+    Areas and splitters are taken from the pool before QToolWindowManager::createArea
+    or QToolWindowManager::createSplitter is called, which avoids the cost of creating
+    and polishing new widgets when tool windows are moved. Set it to 0 if your
+    reimplementations of these functions need a new object each time.
+
+    Closed floating windows are hidden instead of being destroyed, so tearing tool
+    windows off doesn't require creating a new native window each time.
+
+    Default value is 8.
+*/
 /*!
     \enum QToolWindowManager::AreaType
 
@@ -178,12 +240,37 @@ T findClosestParent(QWidget *widget)
     \value ReferenceBottomOf Add to new area to the bottom of the QToolWindowManagerArea.
 
 */
+/*!
+    \enum QToolWindowManager::ExposureState
+
+    Describes whether a tool window can be seen by the user.
+
+    \value ToolWindowExposed The tool window is visible.
+    \value ToolWindowObscuredByTab The tool window is in a non-current tab of its area.
+    \value ToolWindowHidden The tool window is not in the layout or its window is hidden.
+    \value ToolWindowMinimized The window containing the tool window is minimized.
+*/
 /*!
     \fn void QToolWindowManager::toolWindowVisibilityChanged(QWidget* toolWindow, bool visible)
 
     This signal is emitted when \a toolWindow may be hidden or shown.
     \a visible indicates new visibility state of the tool window.
 */
+/*!
+    \fn void QToolWindowManager::toolWindowExposureChanged(QWidget* toolWindow, QToolWindowManager::ExposureState state)
+
+    This signal is emitted when \a toolWindow becomes exposed, obscured by another tab, hidden
+    or minimized. \a state is the new exposure state. Tool windows may use it to pause rendering
+    while the user can't see them. Changes are collected and reported once per event loop
+    iteration.
+*/
+/*!
+    \fn void QToolWindowManager::toolWindowCreated(QWidget* placeholder, QWidget* toolWindow)
+
+    This signal is emitted when a tool window registered with
+    QToolWindowManager::addToolWindowFactory has been created. \a toolWindow has taken
+    the place of \a placeholder in the manager. \a placeholder is deleted later.
+*/
 
 /*!
  * \brief Creates a manager with given \a parent.
@@ -195,14 +282,22 @@ QToolWindowManager::QToolWindowManager(QWidget *parent) :
     d_ptr->q_ptr = this;
     Q_D(QToolWindowManager);
     d->slots_object.d = d;
+    d->m_dragFilter.d = d;
     d->m_lastUsedArea = 0;
     d->m_borderSensitivity = 12;
     d->m_tabsClosable = true;
+    d->m_dragPixmapTabLimit = 10;
+    d->m_recyclePoolSize = 8;
+    d->m_transactionDepth = 0;
+    d->m_dropTargetsValid = false;
+    d->m_dropWrapperGeometryValid = false;
+    d->m_restoringState = false;
     QSplitter *testSplitter = new QSplitter();
     d->m_rubberBandLineWidth = testSplitter->handleWidth();
     delete testSplitter;
     d->m_dragIndicator = new QLabel(0, Qt::ToolTip );
     d->m_dragIndicator->setAttribute(Qt::WA_ShowWithoutActivating);
+    d->m_dragIndicator->setAttribute(Qt::WA_TransparentForMouseEvents);
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
     mainLayout->setContentsMargins(0, 0, 0, 0);
     QToolWindowManagerWrapper* wrapper = new QToolWindowManagerWrapper(this);
@@ -212,9 +307,28 @@ QToolWindowManager::QToolWindowManager(QWidget *parent) :
             &(d->slots_object), SLOT(showNextDropSuggestion()));
     d->m_dropSuggestionSwitchTimer.setInterval(1000);
     d->m_dropCurrentSuggestionIndex = 0;
+    d->m_metadataUpdateTimer.setSingleShot(true);
+    d->m_metadataUpdateTimer.setInterval(16);
+    connect(&(d->m_metadataUpdateTimer), SIGNAL(timeout()),
+            &(d->slots_object), SLOT(updateToolWindowsMetadata()));
+    d->m_exposureUpdateTimer.setSingleShot(true);
+    d->m_exposureUpdateTimer.setInterval(0);
+    connect(&(d->m_exposureUpdateTimer), SIGNAL(timeout()),
+            &(d->slots_object), SLOT(updateExposure()));
+    d->m_dragPositionDirty = false;
+    connect(&(d->m_dragUpdateTimer), SIGNAL(timeout()),
+            &(d->slots_object), SLOT(updateDragPosition()));
+    d->m_autoSaveDirty = false;
+    d->m_autoSaveTimer.setSingleShot(true);
+    d->m_autoSaveTimer.setInterval(1000);
+    connect(&(d->m_autoSaveTimer), SIGNAL(timeout()),
+            &(d->slots_object), SLOT(autoSave()));
+    d->m_autoSavePool.setMaxThreadCount(1);
 
     d->m_rectRubberBand = new QRubberBand(QRubberBand::Rectangle, this);
     d->m_lineRubberBand = new QRubberBand(QRubberBand::Line, this);
+    d->m_rectRubberBand->hide();
+    d->m_lineRubberBand->hide();
 }
 
 /*!
@@ -224,10 +338,15 @@ QToolWindowManager::QToolWindowManager(QWidget *parent) :
 QToolWindowManager::~QToolWindowManager()
 {
     Q_D(QToolWindowManager);
+    flushAutoSave();
     qDeleteAll(d->m_areas);
     d->m_areas.clear();
     qDeleteAll(d->m_wrappers);
     d->m_wrappers.clear();
+    // pooled wrappers access the manager when they are destroyed
+    foreach (QToolWindowManagerWrapper *wrapper, d->m_wrapperPool)
+        delete wrapper;
+    d->m_wrapperPool.clear();
     delete d_ptr;
 }
 
@@ -263,12 +382,15 @@ void QToolWindowManager::addToolWindow(QWidget *toolWindow,
  * \brief Adds \a toolWindows to the manager and moves it to the position specified in \a area.
  * The manager takes ownership of the tool windows and will delete them upon destruction.
  *
- * toolWindow->windowIcon() and toolWindow->windowTitle() will be used as the icon and title
- * of the tab that represents the tool window.
+ * toolWindow->windowIcon(), toolWindow->windowTitle() and toolWindow->toolTip() will be used
+ * as the icon, title and tool tip of the tab that represents the tool window. With Qt 5.2 or
+ * later, changes of the tool tip are applied to the tab with the next change of the title
+ * or the icon.
  *
  * If you intend to use QToolWindowManager::saveState
  * and QToolWindowManager::restoreState functions, you must set objectName() of each added
- * tool window to a non-empty unique string.
+ * tool window to a non-empty unique string. With Qt 4 the object name must not be changed
+ * after the tool window has been added, since such changes aren't reported.
  */
 void QToolWindowManager::addToolWindows(const QWidgetList &toolWindows,
                                         QToolWindowManager::AreaType area)
@@ -346,6 +468,162 @@ void QToolWindowManager::moveToolWindows(const QWidgetList &toolWindows,
                       QToolWindowManagerAreaReference(reference, area));
 }
 
+/*!
+ * Registers a tool window that is constructed only when it's needed and returns
+ * a placeholder widget that represents the tool window until then.
+ *
+ * The placeholder gets \a name as object name, \a title as window title and \a icon
+ * as window icon, so it can be placed by QToolWindowManager::restoreState and displayed as
+ * a tab like any other tool window. It's moved to the position specified in \a area.
+ *
+ * When the placeholder becomes visible (e.g. its tab becomes current), the \a member slot or
+ * invokable method of \a receiver is called with \a name as argument. It must have signature
+ * \c{QWidget *member(const QString &name)} and return the new tool window. The created tool
+ * window replaces the placeholder in its area and QToolWindowManager::toolWindowCreated
+ * is emitted.
+ *
+ * Use this function to avoid constructing tool windows that are hidden or stay in
+ * background tabs.
+ */
+QWidget *QToolWindowManager::addToolWindowFactory(const QString &name, const QString &title,
+                                                  const QIcon &icon, QObject *receiver,
+                                                  const char *member, AreaType area)
+{
+    Q_D(QToolWindowManager);
+    if (name.isEmpty()) {
+        qWarning("cannot add tool window factory without name");
+        return 0;
+    }
+    if (!receiver || !member) {
+        qWarning("invalid tool window factory");
+        return 0;
+    }
+    QByteArray method(member);
+    // skip code of SLOT() or METHOD() macro
+    if (!method.isEmpty() && method[0] >= '0' && method[0] <= '9')
+        method.remove(0, 1);
+    QByteArray signature = QMetaObject::normalizedSignature(method.constData());
+    if (receiver->metaObject()->indexOfMethod(signature.constData()) < 0) {
+        qWarning("tool window factory method '%s' not found", signature.constData());
+        return 0;
+    }
+    method.truncate(method.indexOf('('));
+
+    QWidget *placeholder = new QWidget();
+    placeholder->setObjectName(name);
+    placeholder->setWindowTitle(title);
+    placeholder->setWindowIcon(icon);
+    d->addToolWindows(QWidgetList() << placeholder, QToolWindowManagerAreaReference(NoArea));
+    // the tool window is created when the placeholder is shown
+    placeholder->installEventFilter(&(d->slots_object));
+    QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(placeholder);
+    data->factoryReceiver = receiver;
+    data->factoryMethod = method;
+    if (area != NoArea)
+        moveToolWindow(placeholder, area);
+    return placeholder;
+}
+
+/*!
+ * Returns false if \a toolWindow is a placeholder of a tool window registered with
+ * QToolWindowManager::addToolWindowFactory that hasn't been created yet.
+ */
+bool QToolWindowManager::isToolWindowCreated(QWidget *toolWindow) const
+{
+    const Q_D(QToolWindowManager);
+    const QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(toolWindow);
+    return !data || data->factoryMethod.isEmpty();
+}
+
+/*!
+ * Creates the tool window represented by \a placeholder immediately and returns it.
+ * If \a placeholder is not a placeholder, returns \a placeholder.
+ * Returns 0 if the factory failed to create the tool window.
+ */
+QWidget *QToolWindowManager::createToolWindow(QWidget *placeholder)
+{
+    Q_D(QToolWindowManager);
+    if (isToolWindowCreated(placeholder))
+        return placeholder;
+    return d->createToolWindow(placeholder);
+}
+
+void QToolWindowManagerPrivate::placeholderShown(QWidget *placeholder)
+{
+    // creating the tool window while its area is being shown is not safe, so it's postponed
+    if (m_pendingPlaceholders.isEmpty())
+        QTimer::singleShot(0, &slots_object, SLOT(createPendingToolWindows()));
+    m_pendingPlaceholders << placeholder;
+}
+
+QWidget *QToolWindowManagerPrivate::createToolWindow(QWidget *placeholder)
+{
+    Q_Q(QToolWindowManager);
+    ToolWindowData *data = toolWindowData(placeholder);
+    if (!data || data->factoryMethod.isEmpty())
+        return 0;
+    QPointer<QObject> receiver = data->factoryReceiver;
+    QByteArray method = data->factoryMethod;
+    QString name = placeholder->objectName();
+    if (!receiver) {
+        qWarning("factory of tool window '%s' has been destroyed", name.toLocal8Bit().constData());
+        return 0;
+    }
+    // prevents creating the tool window again if the factory processes events
+    data->factoryMethod.clear();
+    QWidget *toolWindow = 0;
+    if (!QMetaObject::invokeMethod(receiver, method.constData(), Qt::DirectConnection,
+                                   Q_RETURN_ARG(QWidget*, toolWindow), Q_ARG(QString, name)) ||
+            !toolWindow) {
+        qWarning("failed to create tool window '%s'", name.toLocal8Bit().constData());
+        data = toolWindowData(placeholder);
+        if (data)
+            data->factoryMethod = method;
+        return 0;
+    }
+    if (!toolWindowData(placeholder) || toolWindowData(toolWindow)) {
+        qWarning("tool window '%s' has been changed by its factory", name.toLocal8Bit().constData());
+        return toolWindow;
+    }
+    if (toolWindow->objectName().isEmpty())
+        toolWindow->setObjectName(name);
+    if (toolWindow->windowTitle().isEmpty())
+        toolWindow->setWindowTitle(placeholder->windowTitle());
+    if (toolWindow->windowIcon().cacheKey() == qApp->windowIcon().cacheKey())
+        toolWindow->setWindowIcon(placeholder->windowIcon());
+    replaceToolWindow(placeholder, toolWindow);
+    emit q->toolWindowCreated(placeholder, toolWindow);
+    scheduleDeletion(placeholder);
+    return toolWindow;
+}
+
+void QToolWindowManagerPrivate::replaceToolWindow(QWidget *placeholder, QWidget *toolWindow)
+{
+    ToolWindowData data = m_toolWindowData.value(placeholder);
+    QString placeholderName = data.name;
+    data.name = toolWindow->objectName();
+    toolWindow->hide();
+    toolWindow->setParent(0);
+    untrackToolWindow(placeholder);
+    trackToolWindow(toolWindow);
+    m_toolWindowData.insert(toolWindow, data);
+    m_toolWindows[data.index] = toolWindow;
+    int draggedIndex = m_draggedToolWindows.indexOf(placeholder);
+    if (draggedIndex >= 0)
+        m_draggedToolWindows[draggedIndex] = toolWindow;
+    if (data.area) {
+        invalidateSavedState(data.area);
+        data.area->replaceToolWindow(placeholder, toolWindow);
+        placeholder->hide();
+        placeholder->setParent(0);
+        scheduleExposureUpdate(data.area);
+    }
+    m_toolWindowData.remove(placeholder);
+    m_exposureChangedWidgetsSet.remove(placeholder);
+    unindexToolWindowName(placeholder, placeholderName);
+    indexToolWindowName(toolWindow, data.name);
+}
+
 void QToolWindowManagerPrivate::addToolWindows(QList<QWidget *> toolWindows,
                                         const QToolWindowManagerAreaReference &area)
 {
@@ -354,13 +632,18 @@ void QToolWindowManagerPrivate::addToolWindows(QList<QWidget *> toolWindows,
             qWarning("cannot add null widget");
             continue;
         }
-        if (m_toolWindows.contains(toolWindow)) {
+        if (m_toolWindowData.contains(toolWindow)) {
             qWarning("this tool window has already been added");
             continue;
         }
         toolWindow->hide();
         toolWindow->setParent(0);
+        trackToolWindow(toolWindow);
+        ToolWindowData &data = m_toolWindowData[toolWindow];
+        data.index = m_toolWindows.count();
         m_toolWindows << toolWindow;
+        data.name = toolWindow->objectName();
+        indexToolWindowName(toolWindow, data.name);
     }
     moveToolWindows(toolWindows, area);
 }
@@ -370,24 +653,276 @@ void QToolWindowManagerPrivate::addToolWindows(QList<QWidget *> toolWindows,
  */
 QAbstractToolWindowManagerArea *QToolWindowManager::areaFor(QWidget *toolWindow) const
 {
-    return findClosestParent<QAbstractToolWindowManagerArea *>(toolWindow);
+    const Q_D(QToolWindowManager);
+    const QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(toolWindow);
+    return data ? data->area : 0;
+}
+
+/*!
+ * Returns the exposure state of \a toolWindow, i.e. whether the user can see it.
+ * Windows of other applications covering it are not taken into account.
+ */
+QToolWindowManager::ExposureState QToolWindowManager::toolWindowExposure(QWidget *toolWindow) const
+{
+    const Q_D(QToolWindowManager);
+    const QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(toolWindow);
+    return data ? d->computeExposure(toolWindow, *data) : ToolWindowHidden;
+}
+
+QToolWindowManager::ExposureState QToolWindowManagerPrivate::computeExposure(QWidget *toolWindow,
+                                                                 const ToolWindowData &data) const
+{
+    if (!data.area || !data.area->isVisible())
+        return QToolWindowManager::ToolWindowHidden;
+    if (data.area->window()->isMinimized())
+        return QToolWindowManager::ToolWindowMinimized;
+    return toolWindow->isVisible() ? QToolWindowManager::ToolWindowExposed :
+                                     QToolWindowManager::ToolWindowObscuredByTab;
+}
+
+void QToolWindowManagerPrivate::toolWindowMetadataChanged(QWidget *toolWindow)
+{
+    if (m_metadataChangedToolWindowsSet.contains(toolWindow))
+        return;
+    m_metadataChangedToolWindowsSet.insert(toolWindow);
+    m_metadataChangedToolWindows << toolWindow;
+    if (!m_metadataUpdateTimer.isActive())
+        m_metadataUpdateTimer.start();
+}
+
+void QToolWindowManagerPrivate::updateToolWindowsMetadata()
+{
+    QList<QPointer<QWidget> > changedToolWindows = m_metadataChangedToolWindows;
+    m_metadataChangedToolWindows.clear();
+    m_metadataChangedToolWindowsSet.clear();
+    QList<QAbstractToolWindowManagerArea*> areas;
+    QHash<QAbstractToolWindowManagerArea*, QWidgetList> toolWindowsByArea;
+    foreach (QWidget *toolWindow, changedToolWindows) {
+        const ToolWindowData *data = toolWindow ? toolWindowData(toolWindow) : 0;
+        if (!data || !data->area)
+            continue;
+        if (!toolWindowsByArea.contains(data->area))
+            areas << data->area;
+        toolWindowsByArea[data->area] << toolWindow;
+    }
+    foreach (QAbstractToolWindowManagerArea *area, areas)
+        area->toolWindowsChanged(toolWindowsByArea[area]);
+}
+
+void QToolWindowManagerPrivate::scheduleExposureUpdate(QWidget *widget)
+{
+    if (!m_exposureChangedWidgetsSet.contains(widget)) {
+        m_exposureChangedWidgetsSet.insert(widget);
+        m_exposureChangedWidgets << widget;
+    }
+    if (!m_exposureUpdateTimer.isActive())
+        m_exposureUpdateTimer.start();
+}
+
+void QToolWindowManagerPrivate::updateExposure()
+{
+    Q_Q(QToolWindowManager);
+    QList<QPointer<QWidget> > changedWidgets = m_exposureChangedWidgets;
+    m_exposureChangedWidgets.clear();
+    m_exposureChangedWidgetsSet.clear();
+    // a tool window may be listed several times; its state changes only the first time
+    QWidgetList toolWindows;
+    foreach (QWidget *widget, changedWidgets) {
+        if (!widget)
+            continue;
+        if (toolWindowData(widget)) {
+            toolWindows << widget;
+            continue;
+        }
+        if (QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea*>(widget)) {
+            toolWindows << area->toolWindows();
+            continue;
+        }
+        // a wrapper or a widget containing the wrapper inside the manager
+        foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
+            if (wrapper != widget && !widget->isAncestorOf(wrapper))
+                continue;
+            QSet<QWidget*> layoutWidgets;
+            collectLayout(wrapper->content(), layoutWidgets);
+            foreach (QWidget *layoutWidget, layoutWidgets) {
+                if (QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea*>(layoutWidget))
+                    toolWindows << area->toolWindows();
+            }
+        }
+    }
+    QList<QPointer<QWidget> > changedToolWindows;
+    foreach (QWidget *toolWindow, toolWindows) {
+        ToolWindowData *data = toolWindowData(toolWindow);
+        if (!data)
+            continue;
+        QToolWindowManager::ExposureState exposure = computeExposure(toolWindow, *data);
+        if (exposure != data->exposure) {
+            data->exposure = exposure;
+            changedToolWindows << toolWindow;
+        }
+    }
+    // signals are emitted after all states are updated, so receivers see consistent data
+    foreach (QWidget *toolWindow, changedToolWindows) {
+        const ToolWindowData *data = toolWindow ? toolWindowData(toolWindow) : 0;
+        if (data)
+            emit q->toolWindowExposureChanged(toolWindow, data->exposure);
+    }
+}
+
+QToolWindowManagerPrivate::ToolWindowData *QToolWindowManagerPrivate::toolWindowData(QWidget *toolWindow)
+{
+    QHash<QWidget *, ToolWindowData>::iterator it = m_toolWindowData.find(toolWindow);
+    return it == m_toolWindowData.end() ? 0 : &it.value();
+}
+
+const QToolWindowManagerPrivate::ToolWindowData *QToolWindowManagerPrivate::toolWindowData(QWidget *toolWindow) const
+{
+    QHash<QWidget *, ToolWindowData>::const_iterator it = m_toolWindowData.constFind(toolWindow);
+    return it == m_toolWindowData.constEnd() ? 0 : &it.value();
+}
+
+QWidget *QToolWindowManagerPrivate::toolWindowByName(const QString &name)
+{
+    if (name.isEmpty())
+        return 0;
+    // tool windows with the same name are stored most recent first; the first added one wins
+    QWidget *toolWindow = 0;
+    QMultiHash<QString, QWidget *>::const_iterator it = m_toolWindowsByName.constFind(name);
+    for (; it != m_toolWindowsByName.constEnd() && it.key() == name; ++it)
+        toolWindow = it.value();
+    return toolWindow;
+}
+
+void QToolWindowManagerPrivate::trackToolWindow(QWidget *toolWindow)
+{
+#if QT_VERSION < 0x050200
+    // changes of title, icon and tool tip aren't reported by signals
+    toolWindow->installEventFilter(&slots_object);
+#endif
+#if QT_VERSION >= 0x050000
+    QObject::connect(toolWindow, SIGNAL(objectNameChanged(QString)),
+                     &slots_object, SLOT(toolWindowNameChanged()));
+#endif
+#if QT_VERSION >= 0x050200
+    QObject::connect(toolWindow, SIGNAL(windowTitleChanged(QString)),
+                     &slots_object, SLOT(toolWindowMetadataChanged()));
+    QObject::connect(toolWindow, SIGNAL(windowIconChanged(QIcon)),
+                     &slots_object, SLOT(toolWindowMetadataChanged()));
+#endif
+}
+
+void QToolWindowManagerPrivate::untrackToolWindow(QWidget *toolWindow)
+{
+    toolWindow->removeEventFilter(&slots_object);
+    // disconnects all signals listed in trackToolWindow
+    QObject::disconnect(toolWindow, 0, &slots_object, 0);
+}
+
+void QToolWindowManagerPrivate::indexToolWindowName(QWidget *toolWindow, const QString &name)
+{
+    if (!name.isEmpty())
+        m_toolWindowsByName.insert(name, toolWindow);
+}
+
+void QToolWindowManagerPrivate::unindexToolWindowName(QWidget *toolWindow, const QString &name)
+{
+    m_toolWindowsByName.remove(name, toolWindow);
+}
+
+void QToolWindowManagerPrivate::forgetToolWindow(QWidget *toolWindow)
+{
+    QHash<QWidget *, ToolWindowData>::iterator it = m_toolWindowData.find(toolWindow);
+    if (it == m_toolWindowData.end())
+        return;
+    int index = it.value().index;
+    QString name = it.value().name;
+    m_toolWindowData.erase(it);
+    m_exposureChangedWidgetsSet.remove(toolWindow);
+    // the last tool window takes the place of the removed one
+    QWidget *last = m_toolWindows.takeLast();
+    if (last != toolWindow) {
+        m_toolWindows[index] = last;
+        m_toolWindowData[last].index = index;
+    }
+    unindexToolWindowName(toolWindow, name);
+}
+
+void QToolWindowManagerPrivate::toolWindowNameChanged(QWidget *toolWindow)
+{
+    ToolWindowData *data = toolWindowData(toolWindow);
+    if (!data || data->name == toolWindow->objectName())
+        return;
+    unindexToolWindowName(toolWindow, data->name);
+    data->name = toolWindow->objectName();
+    indexToolWindowName(toolWindow, data->name);
+    // saved state of the area contains the name
+    if (data->area)
+        invalidateSavedState(data->area);
+}
+
+#if QT_VERSION < 0x050000
+void QToolWindowManagerPrivate::rebuildToolWindowNames()
+{
+    m_toolWindowsByName.clear();
+    foreach (QWidget *toolWindow, m_toolWindows) {
+        ToolWindowData &data = m_toolWindowData[toolWindow];
+        data.name = toolWindow->objectName();
+        indexToolWindowName(toolWindow, data.name);
+    }
+}
+#endif
+
+void QToolWindowManagerPrivate::addToolWindowsToArea(QAbstractToolWindowManagerArea *area,
+                                                     const QWidgetList &toolWindows)
+{
+    area->addToolWindows(toolWindows);
+    foreach (QWidget *toolWindow, toolWindows)
+        m_toolWindowData[toolWindow].area = area;
+    markDirty(area);
+    invalidateSavedState(area);
+}
+
+void QToolWindowManagerPrivate::markDirty(QAbstractToolWindowManagerArea *area)
+{
+    if (!m_dirtyAreas.contains(area))
+        m_dirtyAreas << area;
+    // tool windows of the area may be shown, hidden or switched to another tab
+    scheduleExposureUpdate(area);
+}
+
+void QToolWindowManagerPrivate::markDirty(QSplitter *splitter)
+{
+    if (!m_dirtySplitters.contains(splitter))
+        m_dirtySplitters << splitter;
 }
 
 void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
                                          const QToolWindowManagerAreaReference& area_param)
 {
     Q_Q(QToolWindowManager);
+    QToolWindowManagerTraceScope trace(&m_trace, "moveToolWindows", toolWindows.count());
     QToolWindowManagerAreaReference area = area_param;
+    beginTransaction();
     foreach (QWidget *toolWindow, toolWindows) {
-        if (!m_toolWindows.contains(toolWindow)) {
+        ToolWindowData *data = toolWindowData(toolWindow);
+        if (!data) {
             qWarning("unknown tool window");
+            commitTransaction();
             return;
         }
-        if (toolWindow->parentWidget() != 0)
+        toolWindowChanged(toolWindow);
+        if (data->area)
             releaseToolWindow(toolWindow);
     }
     if (!area.isReference() && area.areaType() == QToolWindowManager::LastUsedArea && !m_lastUsedArea) {
-        QAbstractToolWindowManagerArea *foundArea = q->findChild<QAbstractToolWindowManagerArea *>();
+        // m_areas doesn't contain pooled areas, unlike children of the manager
+        QAbstractToolWindowManagerArea *foundArea = 0;
+        foreach (QAbstractToolWindowManagerArea *candidate, m_areas) {
+            if (candidate->parentWidget()) {
+                foundArea = candidate;
+                break;
+            }
+        }
         if (foundArea)
             area = QToolWindowManagerAreaReference(QToolWindowManager::ReferenceAddTo, foundArea);
         else
@@ -398,16 +933,16 @@ void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
         //do nothing
     } else if (!area.isReference() && area.areaType() == QToolWindowManager::NewFloatingArea) {
         QAbstractToolWindowManagerArea *area = createAndSetupArea();
-        area->addToolWindows(toolWindows);
+        addToolWindowsToArea(area, toolWindows);
         m_lastUsedArea = area;
-        QToolWindowManagerWrapper *wrapper = new QToolWindowManagerWrapper(q);
+        QToolWindowManagerWrapper *wrapper = createFloatingWrapper();
         wrapper->layout()->addWidget(area);
         wrapper->move(QCursor::pos());
-        wrapper->show();
+        showWrapper(wrapper);
     } else if (area.isReference() && area.referenceType() == QToolWindowManager::ReferenceAddTo) {
         QAbstractToolWindowManagerArea *area2 =
                 static_cast<QAbstractToolWindowManagerArea*>(area.widget());
-        area2->addToolWindows(toolWindows);
+        addToolWindowsToArea(area2, toolWindows);
         m_lastUsedArea = area2;
     } else if (area.isReference()) {
         QSplitter *parentSplitter = qobject_cast<QSplitter*>(area.widget()->parentWidget());
@@ -415,6 +950,7 @@ void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
                 qobject_cast<QToolWindowManagerWrapper*>(area.widget()->parentWidget());
         if (!parentSplitter && !wrapper) {
             qWarning("unknown parent type");
+            commitTransaction();
             return;
         }
         bool useParentSplitter = false;
@@ -433,9 +969,10 @@ void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
                 area.referenceType() == QToolWindowManager::ReferenceRightOf)
                 indexInParentSplitter++;
             QAbstractToolWindowManagerArea *newArea = createAndSetupArea();
-            newArea->addToolWindows(toolWindows);
+            addToolWindowsToArea(newArea, toolWindows);
             m_lastUsedArea = newArea;
             parentSplitter->insertWidget(indexInParentSplitter, newArea);
+            markDirty(parentSplitter);
         } else {
             area.widget()->hide();
             area.widget()->setParent(0);
@@ -457,22 +994,133 @@ void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
                 parentSplitter->insertWidget(indexInParentSplitter, splitter);
             else
                 wrapper->layout()->addWidget(splitter);
-            newArea->addToolWindows(toolWindows);
+            markDirty(splitter);
+            addToolWindowsToArea(newArea, toolWindows);
             m_lastUsedArea = newArea;
         }
     } else if (!area.isReference() && area.areaType() == QToolWindowManager::EmptySpaceArea) {
         QAbstractToolWindowManagerArea *newArea = createAndSetupArea();
         q->findChild<QToolWindowManagerWrapper*>()->layout()->addWidget(newArea);
-        newArea->addToolWindows(toolWindows);
+        addToolWindowsToArea(newArea, toolWindows);
         m_lastUsedArea = newArea;
     } else if (!area.isReference() && area.areaType() == QToolWindowManager::LastUsedArea) {
-        m_lastUsedArea->addToolWindows(toolWindows);
+        addToolWindowsToArea(m_lastUsedArea, toolWindows);
     } else {
         qWarning("invalid type");
     }
+    commitTransaction();
+}
+
+/*!
+ * Starts a layout transaction. Until the matching QToolWindowManager::commitLayoutTransaction
+ * call, adding, moving and removing tool windows doesn't clean up the layout,
+ * repaint the manager and its floating windows or emit
+ * QToolWindowManager::toolWindowVisibilityChanged. These actions are performed only once
+ * when the transaction is committed. Use this to build or change a layout with many calls
+ * at once. Transactions may be nested; only committing the outermost one has effect.
+ *
+ * QToolWindowManagerLayoutTransaction can be used to commit the transaction automatically
+ * at the end of a scope.
+ */
+void QToolWindowManager::beginLayoutTransaction()
+{
+    Q_D(QToolWindowManager);
+    d->beginTransaction();
+}
+
+/*!
+ * Commits the layout transaction started by QToolWindowManager::beginLayoutTransaction.
+ */
+void QToolWindowManager::commitLayoutTransaction()
+{
+    Q_D(QToolWindowManager);
+    if (d->m_transactionDepth == 0) {
+        qWarning("commitLayoutTransaction called without beginLayoutTransaction");
+        return;
+    }
+    d->commitTransaction();
+}
+
+/*!
+    \class QToolWindowManagerLayoutTransaction
+
+    \brief The QToolWindowManagerLayoutTransaction class keeps a layout transaction
+    of QToolWindowManager open during its lifetime.
+
+    \inmodule QtWidgets
+
+    The constructor calls QToolWindowManager::beginLayoutTransaction and the destructor calls
+    QToolWindowManager::commitLayoutTransaction.
+*/
+
+void QToolWindowManagerPrivate::beginTransaction()
+{
+    Q_Q(QToolWindowManager);
+    if (m_transactionDepth++ > 0)
+        return;
+    suspendUpdates(q);
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
+        if (wrapper->isWindow() && wrapper->isVisible())
+            suspendUpdates(wrapper);
+    }
+}
+
+void QToolWindowManagerPrivate::commitTransaction()
+{
+    Q_Q(QToolWindowManager);
+    if (--m_transactionDepth > 0)
+        return;
     simplifyLayout();
-    foreach (QWidget *toolWindow, toolWindows)
-        emit q->toolWindowVisibilityChanged(toolWindow, toolWindow->parent() != 0);
+    normalizeLayout();
+    invalidateDropTargets();
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappersToShow) {
+        if (wrapper)
+            wrapper->show();
+    }
+    m_wrappersToShow.clear();
+    foreach (QWidget *widget, m_suspendedWidgets) {
+        if (widget)
+            widget->setUpdatesEnabled(true);
+    }
+    m_suspendedWidgets.clear();
+    QList<QPointer<QWidget> > changedToolWindows = m_changedToolWindows;
+    m_changedToolWindows.clear();
+    m_changedToolWindowsSet.clear();
+    foreach (QWidget *toolWindow, changedToolWindows) {
+        if (!toolWindow)
+            continue;
+        const ToolWindowData *data = toolWindowData(toolWindow);
+        emit q->toolWindowVisibilityChanged(toolWindow, data && data->area);
+        scheduleExposureUpdate(toolWindow);
+    }
+    scheduleAutoSave();
+#ifndef QT_NO_DEBUG
+    checkLayout();
+#endif
+}
+
+void QToolWindowManagerPrivate::suspendUpdates(QWidget *widget)
+{
+    if (!widget->updatesEnabled())
+        return;
+    widget->setUpdatesEnabled(false);
+    m_suspendedWidgets << widget;
+}
+
+void QToolWindowManagerPrivate::toolWindowChanged(QWidget *toolWindow)
+{
+    if (m_changedToolWindowsSet.contains(toolWindow))
+        return;
+    m_changedToolWindowsSet.insert(toolWindow);
+    m_changedToolWindows << toolWindow;
+}
+
+void QToolWindowManagerPrivate::showWrapper(QToolWindowManagerWrapper *wrapper)
+{
+    if (m_transactionDepth > 0)
+        m_wrappersToShow << wrapper;
+    else
+        wrapper->show();
 }
 
 /*!
@@ -482,16 +1130,21 @@ void QToolWindowManagerPrivate::moveToolWindows(const QWidgetList &toolWindows,
 void QToolWindowManager::removeToolWindow(QWidget *toolWindow)
 {
     Q_D(QToolWindowManager);
-    if (!d->m_toolWindows.contains(toolWindow)) {
+    if (!d->toolWindowData(toolWindow)) {
         qWarning("unknown tool window");
         return;
     }
+    // slots connected to the signals emitted here may add or remove tool windows
     moveToolWindow(toolWindow, NoArea);
-    d->m_toolWindows.removeOne(toolWindow);
+    if (!d->toolWindowData(toolWindow))
+        return;
+    d->untrackToolWindow(toolWindow);
+    d->forgetToolWindow(toolWindow);
 }
 
 /*!
- * \brief Returns all tool window added to the manager.
+ * \brief Returns all tool window added to the manager. The order of the list changes
+ * when tool windows are removed.
  */
 QWidgetList QToolWindowManager::toolWindows() const
 {
@@ -563,8 +1216,105 @@ int QToolWindowManager::rubberBandLineWidth() const
     return d->m_rubberBandLineWidth;
 }
 
+int QToolWindowManager::dragPixmapTabLimit() const
+{
+    const Q_D(QToolWindowManager);
+    return d->m_dragPixmapTabLimit;
+}
+
+void QToolWindowManager::setDragPixmapTabLimit(int count)
+{
+    Q_D(QToolWindowManager);
+    if (d->m_dragPixmapTabLimit != count) {
+        d->m_dragPixmapTabLimit = count;
+        emit dragPixmapTabLimitChanged(count);
+    }
+}
+
+int QToolWindowManager::recyclePoolSize() const
+{
+    const Q_D(QToolWindowManager);
+    return d->m_recyclePoolSize;
+}
+
+void QToolWindowManager::setRecyclePoolSize(int size)
+{
+    Q_D(QToolWindowManager);
+    size = qMax(0, size);
+    if (d->m_recyclePoolSize == size)
+        return;
+    d->m_recyclePoolSize = size;
+    while (d->m_areaPool.count() > size) {
+        QAbstractToolWindowManagerArea *area = d->m_areaPool.takeLast();
+        if (area)
+            d->scheduleDeletion(area);
+    }
+    while (d->m_splitterPool.count() > size) {
+        QSplitter *splitter = d->m_splitterPool.takeLast();
+        if (splitter)
+            d->scheduleDeletion(splitter);
+    }
+    while (d->m_wrapperPool.count() > size) {
+        QToolWindowManagerWrapper *wrapper = d->m_wrapperPool.takeLast();
+        if (wrapper)
+            d->scheduleDeletion(wrapper);
+    }
+    emit recyclePoolSizeChanged(size);
+}
+
+QString QToolWindowManager::autoSaveFileName() const
+{
+    const Q_D(QToolWindowManager);
+    return d->m_autoSaveFileName;
+}
+
+void QToolWindowManager::setAutoSaveFileName(const QString &fileName)
+{
+    Q_D(QToolWindowManager);
+    if (d->m_autoSaveFileName == fileName)
+        return;
+    // pending changes belong to the previous file
+    flushAutoSave();
+    d->m_autoSaveFileName = fileName;
+    d->scheduleAutoSave();
+    emit autoSaveFileNameChanged(fileName);
+}
+
+int QToolWindowManager::autoSaveInterval() const
+{
+    const Q_D(QToolWindowManager);
+    return d->m_autoSaveTimer.interval();
+}
+
+void QToolWindowManager::setAutoSaveInterval(int msec)
+{
+    Q_D(QToolWindowManager);
+    if (d->m_autoSaveTimer.interval() != msec) {
+        d->m_autoSaveTimer.setInterval(msec);
+        emit autoSaveIntervalChanged(msec);
+    }
+}
+
+/*!
+ * Writes pending layout changes to QToolWindowManager::autoSaveFileName and waits until
+ * all autosave writes are finished. Returns false if the last write has failed.
+ * The manager calls this function when it's destroyed.
+ */
+bool QToolWindowManager::flushAutoSave()
+{
+    Q_D(QToolWindowManager);
+    d->m_autoSaveTimer.stop();
+    d->autoSave();
+    d->m_autoSavePool.waitForDone();
+    return d->m_autoSaveFailed.fetchAndAddOrdered(0) == 0;
+}
+
 /*!
- * Returns the widget that is used to display rectangular drop suggestions.
+ * Returns the widget that is used to style rectangular drop suggestions.
+ *
+ * The rubber band is never shown itself. Drop suggestions are painted by an overlay
+ * covering the manager or the floating window using style, palette and style sheet
+ * of the rubber band.
  */
 QRubberBand *QToolWindowManager::rectRubberBand() const
 {
@@ -573,7 +1323,9 @@ QRubberBand *QToolWindowManager::rectRubberBand() const
 }
 
 /*!
- * Returns the widget that is used to display line drop suggestions.
+ * Returns the widget that is used to style line drop suggestions.
+ *
+ * \sa QToolWindowManager::rectRubberBand
  */
 QRubberBand *QToolWindowManager::lineRubberBand() const
 {
@@ -583,15 +1335,20 @@ QRubberBand *QToolWindowManager::lineRubberBand() const
 
 void QToolWindowManager::setTabButton(QWidget* toolWindow, QTabBar::ButtonPosition position, QWidget* widget) {
   Q_D(QToolWindowManager);
-  QAbstractToolWindowManagerArea *area = areaFor(toolWindow);
+  QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(toolWindow);
+  if (!data) {
+      qWarning("unknown tool window");
+      return;
+  }
+  QAbstractToolWindowManagerArea *area = data->area;
   if (area)
       area->beforeTabButtonChanged(toolWindow);
   switch(position) {
   case QTabBar::LeftSide:
-      d->m_toolWindowData[toolWindow].leftButtonWidget = widget;
+      data->leftButtonWidget = widget;
       break;
   case QTabBar::RightSide:
-      d->m_toolWindowData[toolWindow].rightButtonWidget = widget;
+      data->rightButtonWidget = widget;
       break;
   }
   if (area)
@@ -612,6 +1369,11 @@ QSplitter *QToolWindowManager::createSplitter()
  * Dumps the state and position of all tool windows to a variable. It can be stored in application settings
  * using QSettings. Stored state can be restored by calling QToolWindowManager::restoreState
  * with the same value.
+ *
+ * The saved state of each splitter and area is kept until it changes, so saving
+ * an unchanged layout again is cheap. The state of areas created by a reimplemented
+ * QToolWindowManager::createArea is not cached, since their custom data may change
+ * at any time.
  */
 QVariant QToolWindowManager::saveState() const
 {
@@ -636,56 +1398,391 @@ QVariant QToolWindowManager::saveState() const
 
 /*!
   Restores state and position of tool windows stored in \a data.
+
+  Areas, splitters and floating windows of the current layout are reused where the stored
+  layout allows it, and only tool windows that change place are moved. Nothing is done
+  if the current layout already matches \a data.
+
+  \a data may also be a QByteArray containing the state written by
+  QToolWindowManager::saveState(QIODevice*). The layout is left unchanged if \a data
+  is invalid.
+
+  \sa QToolWindowManagerState
 */
 void QToolWindowManager::restoreState(const QVariant &data)
 {
-    Q_D(QToolWindowManager);
     if (!data.isValid())
         return;
-    QVariantMap dataMap = data.toMap();
-    if (dataMap[QLatin1String("QToolWindowManagerStateFormat")].toInt() != 1) {
-        qWarning("state format is not recognized");
-        return;
+    restoreState(QToolWindowManagerState::fromVariant(data));
+}
+
+/*!
+ * Restores state and position of tool windows from \a state, which may have been parsed
+ * in another thread. Returns false and leaves the layout unchanged if \a state is invalid.
+ */
+bool QToolWindowManager::restoreState(const QToolWindowManagerState &state)
+{
+    Q_D(QToolWindowManager);
+    if (!state.isValid()) {
+        qWarning("cannot restore state: %s", qPrintable(state.errorString()));
+        return false;
     }
-    moveToolWindows(d->m_toolWindows, NoArea);
-    QToolWindowManagerWrapper *mainWrapper = findChild<QToolWindowManagerWrapper*>();
+    d->restoreState(state.d->data);
+    return true;
+}
+
+/*!
+ * Writes the spans recorded by QToolWindowManager to \a device as Chrome trace event JSON,
+ * which can be loaded in chrome://tracing or Perfetto. Returns false if writing failed.
+ *
+ * Spans of layout operations (moving tool windows, simplifying and restoring the layout,
+ * finding drop suggestions, generating drag pixmaps) are recorded only if the
+ * "qt.toolwindowmanager.trace" logging category is enabled for debug messages, e.g. with
+ * \c{QT_LOGGING_RULES="qt.toolwindowmanager.trace.debug=true"}. Before Qt 5.4, recording
+ * is enabled by setting the \c QT_TOOLWINDOWMANAGER_TRACE environment variable.
+ */
+bool QToolWindowManager::saveTrace(QIODevice *device) const
+{
+    const Q_D(QToolWindowManager);
+    if (!device || !device->isWritable()) {
+        qWarning("cannot save trace to a device that is not writable");
+        return false;
+    }
+    return d->m_trace.write(device);
+}
+
+/*!
+ * Discards the spans recorded so far.
+ */
+void QToolWindowManager::clearTrace()
+{
+    Q_D(QToolWindowManager);
+    d->m_trace.clear();
+}
+
+/*!
+ * Returns the numbers of widgets created by the manager and an estimate of memory they use.
+ *
+ * The statistics contain the numbers of areas, splitters and wrappers in the layout
+ * (including the wrapper inside the manager), the numbers of them kept for reuse
+ * (see QToolWindowManager::recyclePoolSize), the number of objects scheduled for
+ * deletion, the maximal nesting depth of splitters and the number of all widgets
+ * under the manager, including tool windows and their children.
+ *
+ * unreachableCount is the number of areas and splitters created by the manager that are
+ * neither a part of the layout, nor kept for reuse or scheduled for deletion, and thus will
+ * never be used again, including ones that no longer have a parent. It should always be 0. In debug builds the manager reports such widgets
+ * with a warning after each change of the layout.
+ *
+ * approximateBytes is a rough estimate of memory used by the widgets and internal
+ * data of the manager, useful for spotting growth rather than for exact accounting.
+ */
+QToolWindowManagerStatistics QToolWindowManager::statistics() const
+{
+    const Q_D(QToolWindowManager);
+    QToolWindowManagerStatistics result;
+    QSet<QWidget*> reachable;
+    foreach (QToolWindowManagerWrapper *wrapper, d->m_wrappers) {
+        reachable << wrapper;
+        result.maxSplitterDepth = qMax(result.maxSplitterDepth,
+                                       d->collectLayout(wrapper->content(), reachable));
+    }
+    foreach (QWidget *widget, reachable) {
+        if (qobject_cast<QSplitter*>(widget))
+            result.splitterCount++;
+        else if (qobject_cast<QAbstractToolWindowManagerArea*>(widget))
+            result.areaCount++;
+    }
+    result.wrapperCount = d->m_wrappers.count();
+    foreach (QAbstractToolWindowManagerArea *area, d->m_areaPool) {
+        if (area)
+            result.pooledAreaCount++;
+    }
+    foreach (QSplitter *splitter, d->m_splitterPool) {
+        if (splitter)
+            result.pooledSplitterCount++;
+    }
+    foreach (QToolWindowManagerWrapper *wrapper, d->m_wrapperPool) {
+        if (wrapper)
+            result.pooledWrapperCount++;
+    }
+    foreach (QObject *object, d->m_pendingDeletions) {
+        if (object)
+            result.pendingDeletionCount++;
+    }
+    result.widgetCount = findChildren<QWidget*>().count();
+    result.unreachableCount = d->unreachableWidgets(reachable).count();
+
+    // QWidget with its private data, extra data and the connection list of a typical widget
+    const qint64 approximateWidgetSize = 1024;
+    result.approximateBytes = result.widgetCount * approximateWidgetSize +
+            d->m_toolWindowData.capacity() * qint64(sizeof(QToolWindowManagerPrivate::ToolWindowData)) +
+            d->m_dropTargets.capacity() * qint64(sizeof(QToolWindowManagerPrivate::DropTarget)) +
+            d->m_dropWrappers.capacity() * qint64(sizeof(QToolWindowManagerPrivate::DropWrapper)) +
+            (d->m_suggestions.capacity() + d->m_suggestionBuffer.capacity()) *
+                qint64(sizeof(QToolWindowManagerAreaReference)) +
+            d->m_trace.byteSize();
+    return result;
+}
+
+/*!
+ * Writes the state and position of all tool windows to \a device in a compact binary
+ * format. Unlike QToolWindowManager::saveState(), no intermediate QVariant tree is built.
+ * Returns false if the state could not be written.
+ *
+ * The data starts with a header containing the format version and a checksum, so
+ * QToolWindowManager::restoreState(QIODevice*) rejects corrupt data without changing the layout.
+ */
+bool QToolWindowManager::saveState(QIODevice *device) const
+{
+    const Q_D(QToolWindowManager);
+    if (!device || !device->isWritable()) {
+        qWarning("cannot save state to a device that is not writable");
+        return false;
+    }
+    return d->writeState(device);
+}
+
+/*!
+ * Restores state and position of tool windows from \a device. Both data written by
+ * QToolWindowManager::saveState(QIODevice*) and a QVariant returned by
+ * QToolWindowManager::saveState() and written with QDataStream are accepted.
+ * Returns false and leaves the layout unchanged if the data is invalid.
+ */
+bool QToolWindowManager::restoreState(QIODevice *device)
+{
+    if (!device || !device->isReadable()) {
+        qWarning("cannot restore state from a device that is not readable");
+        return false;
+    }
+    return restoreState(QToolWindowManagerState::fromDevice(device));
+}
+
+static void collectStateNames(const QToolWindowManagerStateNode &node, QSet<QString> &names)
+{
+    foreach (const QString &name, node.objectNames)
+        names.insert(name);
+    foreach (const QToolWindowManagerStateNode &item, node.items)
+        collectStateNames(item, names);
+}
+
+void QToolWindowManagerPrivate::restoreState(const QToolWindowManagerStateData &state)
+{
+    Q_Q(QToolWindowManager);
+    QToolWindowManagerTraceScope trace(&m_trace, "restoreState", m_toolWindows.count());
+#if QT_VERSION < 0x050000
+    // Qt 4 doesn't report object name changes
+    rebuildToolWindowNames();
+#endif
+    QToolWindowManagerWrapper *mainWrapper = q->findChild<QToolWindowManagerWrapper*>();
     if (!mainWrapper) {
         qWarning("can't find main wrapper");
         return;
     }
-    mainWrapper->restoreState(dataMap[QLatin1String("mainWrapper")].toMap());
-    foreach (QVariant windowData, dataMap[QLatin1String("floatingWindows")].toList()) {
-        QToolWindowManagerWrapper *wrapper = new QToolWindowManagerWrapper(this);
-        wrapper->restoreState(windowData.toMap());
-        wrapper->show();
+    QToolWindowManagerStateData currentState;
+    captureState(currentState);
+    if (currentState == state)
+        return;
+
+    QToolWindowManagerLayoutTransaction transaction(q);
+    QSet<QString> names;
+    collectStateNames(state.mainWrapper.root, names);
+    foreach (const QToolWindowManagerStateWindow &windowState, state.floatingWindows)
+        collectStateNames(windowState.root, names);
+    QWidgetList hiddenToolWindows;
+    foreach (QWidget *toolWindow, m_toolWindows) {
+        const ToolWindowData *data = toolWindowData(toolWindow);
+        if (data->area && !names.contains(toolWindow->objectName()))
+            hiddenToolWindows << toolWindow;
+    }
+    q->moveToolWindows(hiddenToolWindows, QToolWindowManager::NoArea);
+
+    QList<QPointer<QWidget> > previousWidgets;
+    foreach (QAbstractToolWindowManagerArea *area, m_areas)
+        previousWidgets << area;
+    QList<QToolWindowManagerWrapper*> floatingWrappers;
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
+        foreach (QSplitter *splitter, wrapper->findChildren<QSplitter*>())
+            previousWidgets << splitter;
+        if (wrapper->isWindow())
+            floatingWrappers << wrapper;
+    }
+
+    // wrappers, splitters and areas are reused in place when the saved layout allows it;
+    // only tool windows that change place are moved
+    m_restoredWidgets.clear();
+    m_pendingSplitterSizes.clear();
+    m_restoringState = true;
+    mainWrapper->restoreState(state.mainWrapper);
+    int floatingIndex = 0;
+    foreach (const QToolWindowManagerStateWindow &windowState, state.floatingWindows) {
+        if (windowState.root.type == QToolWindowManagerStateNode::Empty)
+            continue;
+        if (floatingIndex < floatingWrappers.count()) {
+            floatingWrappers[floatingIndex++]->restoreState(windowState);
+        } else {
+            QToolWindowManagerWrapper *wrapper = createFloatingWrapper();
+            wrapper->restoreState(windowState);
+            showWrapper(wrapper);
+        }
+    }
+
+    // areas that haven't been reused are empty now and are disposed by simplifyLayout
+    foreach (QWidget *widget, previousWidgets) {
+        if (!widget || m_restoredWidgets.contains(widget))
+            continue;
+        QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea*>(widget);
+        if (area && area->parentWidget()) {
+            area->hide();
+            area->setParent(0);
+            markDirty(area);
+        }
+    }
+    foreach (QWidget *widget, previousWidgets) {
+        QSplitter *splitter = qobject_cast<QSplitter*>(widget);
+        if (!splitter || m_restoredWidgets.contains(splitter) || m_splitterPool.contains(splitter))
+            continue;
+        // child splitters are disposed with their parent
+        QSplitter *parentSplitter = qobject_cast<QSplitter*>(splitter->parentWidget());
+        if (parentSplitter && !m_restoredWidgets.contains(parentSplitter))
+            continue;
+        disposeSplitter(splitter);
+    }
+    for (; floatingIndex < floatingWrappers.count(); floatingIndex++)
+        disposeWrapper(floatingWrappers[floatingIndex]);
+    m_restoredWidgets.clear();
+    m_restoringState = false;
+    // the whole layout is built; sizes in wrappers that aren't visible yet
+    // are applied when the wrappers are shown
+    applySplitterSizes();
+}
+
+void QToolWindowManagerPrivate::applySplitterSizes()
+{
+    // Sizes are kept until the wrapper containing the splitter is visible. A hidden wrapper
+    // (e.g. in a manager that hasn't been shown yet) doesn't have its real size.
+    QSet<QWidget*> activatedWrappers;
+    for (int i = 0; i < m_pendingSplitterSizes.count(); i++) {
+        QSplitter *splitter = m_pendingSplitterSizes[i].first;
+        QWidget *wrapper = splitter ? splitter->parentWidget() : 0;
+        while (wrapper && !qobject_cast<QToolWindowManagerWrapper*>(wrapper))
+            wrapper = wrapper->parentWidget();
+        if (!wrapper) {
+            // the splitter has been deleted or removed from the layout
+            m_pendingSplitterSizes.removeAt(i--);
+            continue;
+        }
+        if (!wrapper->isVisible())
+            continue;
+        // lay out the content of the wrapper, so its top level splitter gets its final size
+        if (!activatedWrappers.contains(wrapper)) {
+            wrapper->layout()->activate();
+            activatedWrappers << wrapper;
+        }
+        QList<int> sizes = m_pendingSplitterSizes.takeAt(i--).second;
+        if (sizes.count() != splitter->count())
+            continue;
+        qint64 savedTotal = 0;
+        foreach (int size, sizes)
+            savedTotal += qMax(0, size);
+        int available = (splitter->orientation() == Qt::Horizontal ?
+                             splitter->width() : splitter->height()) -
+                        splitter->handleWidth() * (splitter->count() - 1);
+        if (savedTotal <= 0 || available <= 0) {
+            splitter->setSizes(sizes);
+            continue;
+        }
+        // sizes were saved for a window of possibly different size
+        QList<int> scaledSizes;
+        int used = 0;
+        for (int j = 0; j < sizes.count(); j++) {
+            int size = j == sizes.count() - 1 ? available - used :
+                                                int(qMax(0, sizes[j]) * qint64(available) / savedTotal);
+            scaledSizes << size;
+            used += size;
+        }
+        // this also sets geometry of child splitters, which are handled next
+        splitter->setSizes(scaledSizes);
+        invalidateSavedState(splitter);
     }
-    d->simplifyLayout();
-    foreach (QWidget *toolWindow, d->m_toolWindows)
-        emit toolWindowVisibilityChanged(toolWindow, toolWindow->parentWidget() != 0);
 }
 
 
 void QToolWindowManagerPrivate::handleNoSuggestions()
 {
-    Q_Q(QToolWindowManager);
-    m_rectRubberBand->hide();
-    m_lineRubberBand->hide();
-    m_lineRubberBand->setParent(q);
-    m_rectRubberBand->setParent(q);
-    m_suggestions.clear();
+    if (m_activeOverlay)
+        m_activeOverlay->clearSuggestion();
+    m_activeOverlay = 0;
+    m_suggestions.resize(0);
     m_dropCurrentSuggestionIndex = 0;
     if (m_dropSuggestionSwitchTimer.isActive())
         m_dropSuggestionSwitchTimer.stop();
 }
 
+void QToolWindowManagerPrivate::applySuggestionBuffer()
+{
+    if (m_suggestionBuffer == m_suggestions)
+        return;
+    if (m_suggestionBuffer.isEmpty()) {
+        handleNoSuggestions();
+        return;
+    }
+    // previous suggestions are left in the buffer to reuse its memory
+    m_suggestions.swap(m_suggestionBuffer);
+    m_dropCurrentSuggestionIndex = -1;
+    showNextDropSuggestion();
+    //starting or restarting timer
+    m_dropSuggestionSwitchTimer.start();
+}
+
+QToolWindowManagerOverlay *QToolWindowManagerPrivate::overlayFor(QWidget *parent)
+{
+    for (int i = 0; i < m_overlays.count(); i++) {
+        if (!m_overlays[i]) {
+            m_overlays.removeAt(i--);
+            continue;
+        }
+        if (m_overlays[i]->parentWidget() == parent)
+            return m_overlays[i];
+    }
+    QToolWindowManagerOverlay *overlay = new QToolWindowManagerOverlay(parent);
+    overlay->hide();
+    m_overlays << overlay;
+    return overlay;
+}
+
+void QToolWindowManagerPrivate::showSuggestion(QRubberBand *rubberBand, QWidget *parent,
+                                               const QRect &geometry)
+{
+    QToolWindowManagerOverlay *overlay = overlayFor(parent);
+    if (m_activeOverlay && m_activeOverlay != overlay)
+        m_activeOverlay->clearSuggestion();
+    overlay->setSuggestion(rubberBand, geometry);
+    m_activeOverlay = overlay;
+}
+
+void QToolWindowManagerPrivate::hideOverlays()
+{
+    foreach (QToolWindowManagerOverlay *overlay, m_overlays) {
+        if (overlay) {
+            overlay->clearSuggestion();
+            overlay->hide();
+        }
+    }
+    m_activeOverlay = 0;
+}
+
 void QToolWindowManagerPrivate::releaseToolWindow(QWidget *toolWindow)
 {
-    QAbstractToolWindowManagerArea *previousArea =
-            findClosestParent<QAbstractToolWindowManagerArea *>(toolWindow);
+    ToolWindowData *data = toolWindowData(toolWindow);
+    QAbstractToolWindowManagerArea *previousArea = data ? data->area : 0;
     if (!previousArea) {
         qWarning("cannot find tab widget for tool window");
         return;
     }
+    data->area = 0;
+    markDirty(previousArea);
+    invalidateSavedState(previousArea);
     previousArea->removeToolWindow(toolWindow);
     toolWindow->hide();
     toolWindow->setParent(0);
@@ -693,11 +1790,16 @@ void QToolWindowManagerPrivate::releaseToolWindow(QWidget *toolWindow)
 
 void QToolWindowManagerPrivate::simplifyLayout()
 {
-    foreach (QAbstractToolWindowManagerArea *area, m_areas) {
+    QToolWindowManagerTraceScope trace(&m_trace, "simplifyLayout", m_dirtyAreas.count());
+    // Only branches of changed areas are checked. Disposing an area marks its siblings,
+    // so the list may grow while it's processed.
+    while (!m_dirtyAreas.isEmpty()) {
+        QAbstractToolWindowManagerArea *area = m_dirtyAreas.takeFirst();
+        if (!area)
+            continue;
         if (area->parentWidget() == 0) {
-            if (area->toolWindows().isEmpty()) {
-                area->deleteLater();
-            }
+            if (area->toolWindows().isEmpty())
+                disposeArea(area);
             continue;
         }
         QSplitter *splitter = qobject_cast<QSplitter*>(area->parentWidget());
@@ -716,11 +1818,10 @@ void QToolWindowManagerPrivate::simplifyLayout()
                     findClosestParent<QToolWindowManagerWrapper*>(area);
             if (!wrapper) {
                 qWarning("can't find wrapper");
-                return;
+                continue;
             }
             if (area->toolWindows().isEmpty() && wrapper->isWindow()) {
-                wrapper->hide();
-                wrapper->deleteLater();
+                disposeWrapper(wrapper);
             } else if (area->parent() != wrapper) {
                 wrapper->layout()->addWidget(area);
             }
@@ -730,19 +1831,297 @@ void QToolWindowManagerPrivate::simplifyLayout()
             int index = validSplitter->indexOf(invalidSplitter);
             validSplitter->insertWidget(index, area);
         }
-        if (invalidSplitter) {
-            invalidSplitter->hide();
-            invalidSplitter->setParent(0);
-            invalidSplitter->deleteLater();
+        if (validSplitter)
+            markDirty(validSplitter);
+        if (area->toolWindows().isEmpty())
+            disposeArea(area);
+        if (invalidSplitter)
+            disposeSplitter(invalidSplitter);
+    }
+}
+
+namespace {
+
+// Encodes a snapshot of the layout and writes it to the autosave file in a worker thread.
+class AutoSaveJob : public QRunnable
+{
+public:
+    AutoSaveJob(const QString &fileName, const QToolWindowManagerStateData &state,
+                QAtomicInt *failed) :
+        m_fileName(fileName), m_state(state), m_failed(failed) {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+#if QT_VERSION >= 0x050100
+        QSaveFile file(m_fileName);
+        bool ok = file.open(QIODevice::WriteOnly) &&
+                  QToolWindowManagerStatePrivate::write(&file, m_state) &&
+                  file.commit();
+#else
+        QFile file(m_fileName);
+        bool ok = file.open(QIODevice::WriteOnly) &&
+                  QToolWindowManagerStatePrivate::write(&file, m_state);
+#endif
+        if (!ok)
+            qWarning("cannot write autosave file '%s'", qPrintable(m_fileName));
+        m_failed->fetchAndStoreOrdered(ok ? 0 : 1);
+    }
+
+private:
+    QString m_fileName;
+    QToolWindowManagerStateData m_state;
+    QAtomicInt *m_failed;
+};
+
+} // namespace
+
+void QToolWindowManagerPrivate::scheduleAutoSave()
+{
+    if (m_autoSaveFileName.isEmpty())
+        return;
+    m_autoSaveDirty = true;
+    // restarting the timer collects a series of changes into one save
+    m_autoSaveTimer.start();
+}
+
+void QToolWindowManagerPrivate::autoSave()
+{
+    Q_Q(QToolWindowManager);
+    if (!m_autoSaveDirty || m_autoSaveFileName.isEmpty())
+        return;
+    m_autoSaveDirty = false;
+    if (!q->findChild<QToolWindowManagerWrapper*>())
+        return;
+    QToolWindowManagerTraceScope trace(&m_trace, "autoSave", m_toolWindows.count());
+    QToolWindowManagerStateData state;
+    captureState(state);
+    m_autoSavePool.start(new AutoSaveJob(m_autoSaveFileName, state, &m_autoSaveFailed));
+}
+
+void QToolWindowManagerPrivate::normalizeLayout()
+{
+    QToolWindowManagerTraceScope trace(&m_trace, "normalizeLayout", m_dirtySplitters.count());
+    // whole trees are normalized, since a changed splitter may be merged into its parent
+    QList<QSplitter*> roots;
+    foreach (QSplitter *splitter, m_dirtySplitters) {
+        if (!splitter || m_splitterPool.contains(splitter))
+            continue;
+        while (QSplitter *parentSplitter = qobject_cast<QSplitter*>(splitter->parentWidget()))
+            splitter = parentSplitter;
+        if (!roots.contains(splitter) && qobject_cast<QToolWindowManagerWrapper*>(splitter->parentWidget()))
+            roots << splitter;
+    }
+    m_dirtySplitters.clear();
+    foreach (QSplitter *root, roots) {
+        // a root with a single splitter item takes the orientation of the item to absorb it
+        QSplitter *item = root->count() == 1 ? qobject_cast<QSplitter*>(root->widget(0)) : 0;
+        if (item) {
+            root->setOrientation(item->orientation());
+            invalidateSavedState(root);
+        }
+        normalizeSplitter(root);
+    }
+}
+
+void QToolWindowManagerPrivate::normalizeSplitter(QSplitter *splitter)
+{
+    QList<int> sizes = splitter->sizes();
+    bool changed = false;
+    for (int i = 0; i < splitter->count(); i++) {
+        QSplitter *item = qobject_cast<QSplitter*>(splitter->widget(i));
+        if (!item)
+            continue;
+        normalizeSplitter(item);
+        if (item->count() > 1 && item->orientation() != splitter->orientation())
+            continue;
+        // Items of the nested splitter are moved to this one. They share the space
+        // of the nested splitter in the same proportions, so nothing moves on screen.
+        QList<int> itemSizes = item->sizes();
+        qint64 itemTotal = 0;
+        foreach (int size, itemSizes)
+            itemTotal += size;
+        int slot = sizes.value(i);
+        QList<int> newSizes;
+        int used = 0;
+        for (int j = 0; j < itemSizes.count(); j++) {
+            int size = j == itemSizes.count() - 1 ? slot - used :
+                       itemTotal > 0 ? int(itemSizes[j] * qint64(slot) / itemTotal) :
+                                       slot / itemSizes.count();
+            newSizes << size;
+            used += size;
         }
-        if (area->toolWindows().isEmpty()) {
-            area->hide();
-            area->setParent(0);
-            area->deleteLater();
+        QWidgetList widgets;
+        for (int j = 0; j < item->count(); j++)
+            widgets << item->widget(j);
+        for (int j = 0; j < widgets.count(); j++) {
+            splitter->insertWidget(i + j, widgets[j]);
+            widgets[j]->show();
         }
+        disposeSplitter(item);
+        sizes.removeAt(i);
+        for (int j = 0; j < newSizes.count(); j++)
+            sizes.insert(i + j, newSizes[j]);
+        // merged items have already been normalized
+        i += widgets.count() - 1;
+        changed = true;
+    }
+    if (changed) {
+        splitter->setSizes(sizes);
+        invalidateDropTargets();
+        invalidateSavedState(splitter);
     }
 }
 
+void QToolWindowManagerPrivate::recycle(QWidget *widget)
+{
+    Q_Q(QToolWindowManager);
+    widget->setParent(q);
+    // make it look like a new widget, so layouts and splitters show it when it's inserted
+    widget->setAttribute(Qt::WA_WState_ExplicitShowHide, false);
+}
+
+void QToolWindowManagerPrivate::disposeArea(QAbstractToolWindowManagerArea *area)
+{
+    if (area == m_lastUsedArea)
+        m_lastUsedArea = 0;
+    // the parent splitter may become useless
+    QSplitter *parentSplitter = qobject_cast<QSplitter*>(area->parentWidget());
+    if (parentSplitter) {
+        for (int i = 0; i < parentSplitter->count(); i++) {
+            QAbstractToolWindowManagerArea *sibling =
+                    qobject_cast<QAbstractToolWindowManagerArea*>(parentSplitter->widget(i));
+            if (sibling && sibling != area)
+                markDirty(sibling);
+        }
+        markDirty(parentSplitter);
+    }
+    m_dirtyAreas.removeAll(area);
+    m_areas.removeOne(area);
+    invalidateSavedState(area);
+    if (m_areaPool.count() < m_recyclePoolSize) {
+        recycle(area);
+        m_areaPool << area;
+        invalidateDropTargets();
+    } else {
+        area->hide();
+        area->setParent(0);
+        scheduleDeletion(area);
+    }
+}
+
+void QToolWindowManagerPrivate::disposeSplitter(QSplitter *splitter)
+{
+    invalidateSavedState(splitter);
+    splitter->hide();
+    splitter->setParent(0);
+    for (int i = splitter->count() - 1; i >= 0; i--) {
+        QSplitter *childSplitter = qobject_cast<QSplitter*>(splitter->widget(i));
+        if (childSplitter)
+            disposeSplitter(childSplitter);
+    }
+    if (splitter->count() == 0 && m_splitterPool.count() < m_recyclePoolSize) {
+        recycle(splitter);
+        m_splitterPool << splitter;
+    } else {
+        scheduleDeletion(splitter);
+    }
+}
+
+void QToolWindowManagerPrivate::disposeWrapper(QToolWindowManagerWrapper *wrapper)
+{
+    m_wrappersToShow.removeAll(wrapper);
+    m_topLevelOrder.removeAll(wrapper);
+    wrapper->hide();
+    // the area left in the wrapper is disposed by simplifyLayout
+    QWidget *content = wrapper->content();
+    if (content) {
+        content->hide();
+        content->setParent(0);
+    }
+    // Pooled wrappers keep their native windows, so tearing tool windows off
+    // doesn't make the window system create a new window each time.
+    if (m_wrapperPool.count() < m_recyclePoolSize) {
+        m_wrappers.removeOne(wrapper);
+        m_wrapperPool << wrapper;
+        invalidateDropTargets();
+    } else {
+        scheduleDeletion(wrapper);
+    }
+}
+
+void QToolWindowManagerPrivate::scheduleDeletion(QObject *object)
+{
+    for (int i = 0; i < m_pendingDeletions.count(); i++) {
+        if (!m_pendingDeletions[i])
+            m_pendingDeletions.removeAt(i--);
+    }
+    m_pendingDeletions << object;
+    if (object->isWidgetType())
+        m_layoutWidgets.remove(static_cast<QWidget*>(object));
+    object->deleteLater();
+}
+
+int QToolWindowManagerPrivate::collectLayout(QWidget *widget, QSet<QWidget*> &reachable) const
+{
+    if (!widget)
+        return 0;
+    reachable << widget;
+    QSplitter *splitter = qobject_cast<QSplitter*>(widget);
+    if (!splitter)
+        return 0;
+    int depth = 0;
+    for (int i = 0; i < splitter->count(); i++)
+        depth = qMax(depth, collectLayout(splitter->widget(i), reachable));
+    return depth + 1;
+}
+
+QWidgetList QToolWindowManagerPrivate::unreachableWidgets(const QSet<QWidget*> &reachable) const
+{
+    QSet<QWidget*> kept;
+    foreach (QAbstractToolWindowManagerArea *area, m_areaPool)
+        kept << area;
+    foreach (QSplitter *splitter, m_splitterPool)
+        kept << splitter;
+    // empty areas are removed from the layout by simplifyLayout
+    foreach (QAbstractToolWindowManagerArea *area, m_dirtyAreas)
+        kept << area;
+
+    QWidgetList result;
+    foreach (QWidget *widget, m_layoutWidgets) {
+        if (!reachable.contains(widget) && !kept.contains(widget))
+            result << widget;
+    }
+    return result;
+}
+
+void QToolWindowManagerPrivate::checkLayout() const
+{
+    QSet<QWidget*> reachable;
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers)
+        collectLayout(wrapper->content(), reachable);
+    foreach (QWidget *widget, unreachableWidgets(reachable)) {
+        qWarning("QToolWindowManager: %s '%s' is not reachable from any wrapper",
+                 widget->metaObject()->className(), qPrintable(widget->objectName()));
+    }
+}
+
+QToolWindowManagerWrapper *QToolWindowManagerPrivate::createFloatingWrapper()
+{
+    Q_Q(QToolWindowManager);
+    while (!m_wrapperPool.isEmpty()) {
+        QToolWindowManagerWrapper *wrapper = m_wrapperPool.takeLast();
+        if (!wrapper)
+            continue;
+        wrapper->setWindowState(Qt::WindowNoState);
+        // let the window be sized according to its new content when it's shown
+        wrapper->setAttribute(Qt::WA_Resized, false);
+        m_wrappers << wrapper;
+        invalidateDropTargets();
+        return wrapper;
+    }
+    return new QToolWindowManagerWrapper(q);
+}
+
 void QToolWindowManagerPrivate::startDrag(const QWidgetList &toolWindows)
 {
     Q_Q(QToolWindowManager);
@@ -753,12 +2132,38 @@ void QToolWindowManagerPrivate::startDrag(const QWidgetList &toolWindows)
     if (toolWindows.isEmpty())
         return;
     m_draggedToolWindows = toolWindows;
+    buildDropTargets();
+    // a drop target yields at most one suggestion per side and one for adding to the area,
+    // so suggestion buffers don't need to grow while dragging
+    int maxSuggestions = m_dropTargets.count() * (DropTarget::SideCount + 1) + 1;
+    m_suggestions.reserve(maxSuggestions);
+    m_suggestionBuffer.reserve(maxSuggestions);
     m_dragIndicator->setPixmap(q->generateDragPixmap(toolWindows));
+    int frameInterval = 16;
+#if QT_VERSION >= 0x050000
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen && screen->refreshRate() > 0)
+        frameInterval = qMax(1, qRound(1000 / screen->refreshRate()));
+#endif
+    m_dragUpdateTimer.setInterval(frameInterval);
+    // the timer runs for the whole drag; restarting it on each mouse move would
+    // register a new timer every time
+    m_dragUpdateTimer.start();
+    // mouse events are tracked for the whole application, so the drag
+    // doesn't depend on the widget that has started it
+    qApp->installEventFilter(&m_dragFilter);
     updateDragPosition();
     m_dragIndicator->show();
 }
 
 QVariantMap QToolWindowManagerPrivate::saveAreaState(QAbstractToolWindowManagerArea *area) {
+    // custom data of other area classes may change without notice
+    bool cacheable = area->metaObject() == &QToolWindowManagerArea::staticMetaObject;
+    if (cacheable) {
+        QHash<QWidget*, QVariantMap>::const_iterator it = m_savedStateCache.constFind(area);
+        if (it != m_savedStateCache.constEnd())
+            return it.value();
+    }
     QVariantMap result;
     result[QLatin1String("type")] = QLatin1String("area");
     QStringList objectNames;
@@ -771,37 +2176,21 @@ QVariantMap QToolWindowManagerPrivate::saveAreaState(QAbstractToolWindowManagerA
     }
     result[QLatin1String("objectNames")] = objectNames;
     result[QLatin1String("customData")] = area->saveState();
+    if (cacheable)
+        m_savedStateCache.insert(area, result);
     return result;
 }
 
-QAbstractToolWindowManagerArea *QToolWindowManagerPrivate::restoreAreaState(const QVariantMap &data) {
-    QWidgetList toolWindows;
-    foreach (QVariant objectNameValue, data[QLatin1String("objectNames")].toList()) {
-        QString objectName = objectNameValue.toString();
-        if (objectName.isEmpty()) { continue; }
-        bool found = false;
-        foreach (QWidget *toolWindow, m_toolWindows) {
-            if (toolWindow->objectName() == objectName) {
-                toolWindows << toolWindow;
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-            qWarning("tool window with name '%s' not found", objectName.toLocal8Bit().constData());
-    }
-    QAbstractToolWindowManagerArea *area = createAndSetupArea();
-    area->addToolWindows(toolWindows);
-    area->restoreState(data[QLatin1String("customData")]);
-    return area;
-}
-
 QVariantMap QToolWindowManagerPrivate::saveSplitterState(QSplitter *splitter)
 {
+    QHash<QWidget*, QVariantMap>::const_iterator it = m_savedStateCache.constFind(splitter);
+    if (it != m_savedStateCache.constEnd())
+        return it.value();
     QVariantMap result;
     result[QLatin1String("state")] = splitter->saveState();
     result[QLatin1String("type")] = QLatin1String("splitter");
     QVariantList items;
+    bool cacheable = true;
     for (int i = 0; i < splitter->count(); i++) {
         QWidget *item = splitter->widget(i);
         QVariantMap itemValue;
@@ -816,50 +2205,257 @@ QVariantMap QToolWindowManagerPrivate::saveSplitterState(QSplitter *splitter)
                 qWarning("unknown splitter item");
         }
         items << itemValue;
+        cacheable = cacheable && m_savedStateCache.contains(item);
     }
     result[QLatin1String("items")] = items;
+    if (cacheable)
+        m_savedStateCache.insert(splitter, result);
     return result;
 }
 
-QSplitter *QToolWindowManagerPrivate::restoreSplitterState(const QVariantMap &data)
+void QToolWindowManagerPrivate::invalidateSavedState(QWidget *widget)
+{
+    // parents of a widget that isn't cached aren't cached either
+    while (widget) {
+        bool removed = m_savedStateCache.remove(widget) > 0;
+        if (m_capturedStateCache.remove(widget) == 0 && !removed)
+            break;
+        widget = widget->parentWidget();
+    }
+}
+
+QWidget *QToolWindowManagerPrivate::restoreNodeState(const QToolWindowManagerStateNode &node,
+                                                     QWidget *previous)
+{
+    switch (node.type) {
+    case QToolWindowManagerStateNode::Area:
+        return restoreAreaState(node);
+    case QToolWindowManagerStateNode::Splitter:
+        return restoreSplitterState(node, previous);
+    default:
+        return 0;
+    }
+}
+
+QAbstractToolWindowManagerArea *QToolWindowManagerPrivate::restoreAreaState(const QToolWindowManagerStateNode &node)
+{
+    QWidgetList toolWindows;
+    foreach (const QString &objectName, node.objectNames) {
+        if (objectName.isEmpty()) { continue; }
+        QWidget *toolWindow = toolWindowByName(objectName);
+        if (toolWindow)
+            toolWindows << toolWindow;
+        else
+            qWarning("tool window with name '%s' not found", objectName.toLocal8Bit().constData());
+    }
+    // The area containing the first tool window is reused. Its tabs are kept if they are
+    // a prefix of the saved ones after removing foreign tabs, so adding or removing
+    // a tab doesn't touch the others.
+    QAbstractToolWindowManagerArea *area = 0;
+    QWidgetList keptToolWindows;
+    const ToolWindowData *firstData = toolWindows.isEmpty() ? 0 : toolWindowData(toolWindows.first());
+    if (firstData && firstData->area && !m_restoredWidgets.contains(firstData->area)) {
+        area = firstData->area;
+        QSet<QWidget*> toolWindowsSet = toolWindows.toSet();
+        foreach (QWidget *toolWindow, area->toolWindows()) {
+            if (toolWindowsSet.contains(toolWindow)) {
+                keptToolWindows << toolWindow;
+            } else {
+                toolWindowChanged(toolWindow);
+                releaseToolWindow(toolWindow);
+            }
+        }
+        if (keptToolWindows != toolWindows.mid(0, keptToolWindows.count())) {
+            foreach (QWidget *toolWindow, keptToolWindows) {
+                toolWindowChanged(toolWindow);
+                releaseToolWindow(toolWindow);
+            }
+            keptToolWindows.clear();
+        }
+    } else {
+        area = createAndSetupArea();
+    }
+    QWidgetList addedToolWindows = toolWindows.mid(keptToolWindows.count());
+    foreach (QWidget *toolWindow, addedToolWindows) {
+        toolWindowChanged(toolWindow);
+        if (toolWindowData(toolWindow)->area)
+            releaseToolWindow(toolWindow);
+    }
+    addToolWindowsToArea(area, addedToolWindows);
+    area->restoreState(node.customData);
+    invalidateSavedState(area);
+    m_restoredWidgets << area;
+    return area;
+}
+
+QSplitter *QToolWindowManagerPrivate::restoreSplitterState(const QToolWindowManagerStateNode &node,
+                                                           QWidget *previous)
 {
-    //Q_Q(QToolWindowManager);
-    if (data[QLatin1String("items")].toList().count() < 2)
+    QToolWindowManagerTraceScope trace(&m_trace, "restoreSplitterState", node.items.count());
+    if (node.items.count() < 2)
         qWarning("invalid splitter encountered");
 
-    QSplitter *splitter = createAndSetupSplitter();
-    foreach (QVariant itemData, data[QLatin1String("items")].toList()) {
-        QVariantMap itemValue = itemData.toMap();
-        QString itemType = itemValue[QLatin1String("type")].toString();
-        if (itemType == QLatin1String("splitter")) {
-            splitter->addWidget(restoreSplitterState(itemValue));
-        } else if (itemType == QLatin1String("area")) {
-            splitter->addWidget(restoreAreaState(itemValue));
-        } else {
+    QSplitter *splitter = qobject_cast<QSplitter*>(previous);
+    if (!splitter || m_restoredWidgets.contains(splitter))
+        splitter = createAndSetupSplitter();
+    m_restoredWidgets << splitter;
+    markDirty(splitter);
+    invalidateSavedState(splitter);
+    splitter->setOrientation(node.orientation);
+    QWidgetList previousItems;
+    for (int i = 0; i < splitter->count(); i++)
+        previousItems << splitter->widget(i);
+    int index = 0;
+    foreach (const QToolWindowManagerStateNode &item, node.items) {
+        QWidget *widget = restoreNodeState(item, index < previousItems.count() ? previousItems[index] : 0);
+        if (!widget) {
             qWarning("unknown item type");
+            continue;
         }
+        if (splitter->indexOf(widget) != index)
+            splitter->insertWidget(index, widget);
+        widget->show();
+        index++;
+    }
+    // previous items that are still here may be reused later in another place
+    while (splitter->count() > index) {
+        QWidget *widget = splitter->widget(index);
+        widget->hide();
+        widget->setParent(0);
     }
-    splitter->restoreState(data[QLatin1String("state")].toByteArray());
+    // children are restored after their parent, so the parent is prepended later
+    if (node.sizes.count() == splitter->count())
+        m_pendingSplitterSizes.prepend(qMakePair(QPointer<QSplitter>(splitter), node.sizes));
     return splitter;
 }
 
+void QToolWindowManagerPrivate::captureNodeState(QWidget *widget,
+                                                 QToolWindowManagerStateNode &node) const
+{
+    if (!widget)
+        return;
+    QHash<QWidget*, QToolWindowManagerStateNode>::const_iterator it =
+            m_capturedStateCache.constFind(widget);
+    if (it != m_capturedStateCache.constEnd()) {
+        node = it.value();
+        return;
+    }
+    bool cacheable = false;
+    if (QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea*>(widget)) {
+        node.type = QToolWindowManagerStateNode::Area;
+        foreach (QWidget *toolWindow, area->toolWindows()) {
+            QString name = toolWindow->objectName();
+            if (name.isEmpty())
+                qWarning("cannot save state of tool window without object name");
+            else
+                node.objectNames << name;
+        }
+        node.customData = area->saveState();
+        // same rules as in saveAreaState
+        cacheable = area->metaObject() == &QToolWindowManagerArea::staticMetaObject;
+    } else if (QSplitter *splitter = qobject_cast<QSplitter*>(widget)) {
+        node.type = QToolWindowManagerStateNode::Splitter;
+        node.orientation = splitter->orientation();
+        node.sizes = splitter->sizes();
+        cacheable = true;
+        for (int i = 0; i < splitter->count(); i++) {
+            node.items << QToolWindowManagerStateNode();
+            captureNodeState(splitter->widget(i), node.items.last());
+            cacheable = cacheable && m_capturedStateCache.contains(splitter->widget(i));
+        }
+    } else {
+        qWarning("unknown splitter item");
+    }
+    if (cacheable)
+        m_capturedStateCache.insert(widget, node);
+}
+
+void QToolWindowManagerPrivate::captureWindowState(QToolWindowManagerWrapper *wrapper,
+                                                   QToolWindowManagerStateWindow &window) const
+{
+    window.geometry = wrapper->saveGeometry();
+    QLayout *layout = wrapper->layout();
+    if (layout->count() > 1)
+        qWarning("too many children for wrapper");
+    if (wrapper->isWindow() && layout->count() == 0)
+        qWarning("empty top level wrapper");
+    captureNodeState(layout->count() > 0 ? layout->itemAt(0)->widget() : 0, window.root);
+}
+
+void QToolWindowManagerPrivate::captureState(QToolWindowManagerStateData &state) const
+{
+    Q_Q(const QToolWindowManager);
+    QToolWindowManagerWrapper *mainWrapper = q->findChild<QToolWindowManagerWrapper*>();
+    if (mainWrapper)
+        captureWindowState(mainWrapper, state.mainWrapper);
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
+        if (!wrapper->isWindow())
+            continue;
+        state.floatingWindows << QToolWindowManagerStateWindow();
+        captureWindowState(wrapper, state.floatingWindows.last());
+    }
+}
+
+bool QToolWindowManagerPrivate::writeState(QIODevice *device) const
+{
+    Q_Q(const QToolWindowManager);
+    QToolWindowManagerTraceScope trace(&m_trace, "saveState", m_toolWindows.count());
+    if (!q->findChild<QToolWindowManagerWrapper*>()) {
+        qWarning("can't find main wrapper");
+        return false;
+    }
+    QToolWindowManagerStateData state;
+    captureState(state);
+    return QToolWindowManagerStatePrivate::write(device, state);
+}
+
 /*!
  * Generates a pixmap for \a toolWindows that is used to represent the data
  * in a drag and drop operation near the mouse cursor.
  * You may reimplement this function to use different pixmaps.
+ *
+ * The default implementation draws a tab bar with a tab for each of the tool windows
+ * (but no more than QToolWindowManager::dragPixmapTabLimit tabs). Generated pixmaps
+ * are stored in QPixmapCache, keyed on titles and icons of the tool windows.
  */
 QPixmap QToolWindowManager::generateDragPixmap(const QList<QWidget *> &toolWindows)
 {
+    Q_D(QToolWindowManager);
+    QToolWindowManagerTraceScope trace(&d->m_trace, "generateDragPixmap", toolWindows.count());
+    int tabCount = toolWindows.count();
+    if (d->m_dragPixmapTabLimit > 0 && tabCount > d->m_dragPixmapTabLimit)
+        tabCount = d->m_dragPixmapTabLimit;
+    QString key = QLatin1String("QToolWindowManager_drag");
+#if QT_VERSION >= 0x050100
+    key += QLatin1Char('@') + QString::number(devicePixelRatio());
+#endif
+    for (int i = 0; i < tabCount; i++) {
+        QWidget *toolWindow = toolWindows[i];
+        key += QLatin1Char('\n') + QString::number(toolWindow->windowIcon().cacheKey()) +
+               QLatin1Char(' ') + toolWindow->windowTitle();
+    }
+    if (tabCount < toolWindows.count())
+        key += QLatin1String("\n+") + QString::number(toolWindows.count() - tabCount);
+
+    QPixmap pixmap;
+    if (QPixmapCache::find(key, &pixmap))
+        return pixmap;
+
     QTabBar widget;
     widget.setDocumentMode(true);
-    foreach (QWidget *toolWindow, toolWindows) {
+    for (int i = 0; i < tabCount; i++) {
+        QWidget *toolWindow = toolWindows[i];
         widget.addTab(toolWindow->windowIcon(), toolWindow->windowTitle());
     }
+    if (tabCount < toolWindows.count())
+        widget.addTab(tr("+%1").arg(toolWindows.count() - tabCount));
     #if QT_VERSION >= 0x050000 // Qt5
-        return widget.grab();
+        pixmap = widget.grab();
     #else //Qt4
-        return QPixmap::grabWidget(&widget);
+        pixmap = QPixmap::grabWidget(&widget);
     #endif
+    QPixmapCache::insert(key, pixmap);
+    return pixmap;
 }
 
 void QToolWindowManagerPrivate::showNextDropSuggestion()
@@ -890,10 +2486,7 @@ void QToolWindowManagerPrivate::showNextDropSuggestion()
         QRect placeHolderGeometry = widget->rect();
         placeHolderGeometry.moveTopLeft(widget->mapTo(placeHolderParent,
                                                       placeHolderGeometry.topLeft()));
-        m_rectRubberBand->setGeometry(placeHolderGeometry);
-        m_rectRubberBand->setParent(placeHolderParent);
-        m_rectRubberBand->show();
-        m_lineRubberBand->hide();
+        showSuggestion(m_rectRubberBand, placeHolderParent, placeHolderGeometry);
     } else if (suggestion.isReference() &&
                suggestion.referenceType() != QToolWindowManager::ReferenceAddTo) {
         QWidget *placeHolderParent;
@@ -906,61 +2499,145 @@ void QToolWindowManagerPrivate::showNextDropSuggestion()
         placeHolderGeometry.moveTopLeft(suggestion.widget()->mapTo(placeHolderParent,
                                                                    placeHolderGeometry.topLeft()));
 
-        m_lineRubberBand->setGeometry(placeHolderGeometry);
-        m_lineRubberBand->setParent(placeHolderParent);
-        m_lineRubberBand->show();
-        m_rectRubberBand->hide();
+        showSuggestion(m_lineRubberBand, placeHolderParent, placeHolderGeometry);
     } else {
         qWarning("unsupported suggestion type");
     }
 }
 
+// sides of drop target candidates in the order they are suggested
+static const QToolWindowManager::ReferenceType dropTargetSides[] = {
+    QToolWindowManager::ReferenceLeftOf,
+    QToolWindowManager::ReferenceTopOf,
+    QToolWindowManager::ReferenceRightOf,
+    QToolWindowManager::ReferenceBottomOf
+};
+
+void QToolWindowManagerPrivate::buildDropTargets()
+{
+    // suggestions compare equal regardless of geometry, so the displayed suggestion
+    // must not be kept when its geometry may have changed
+    m_suggestions.resize(0);
+    m_dropWrappers.clear();
+    m_dropTargets.clear();
+    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
+        QWidget *topLevel = wrapper->topLevelWidget();
+        DropWrapper dropWrapper;
+        dropWrapper.wrapper = wrapper;
+        dropWrapper.topLevel = topLevel;
+        dropWrapper.rect = QRect(wrapper->mapTo(topLevel, QPoint(0, 0)), wrapper->size());
+        dropWrapper.firstTarget = m_dropTargets.count();
+        QWidgetList candidates;
+        foreach (QSplitter *splitter, wrapper->findChildren<QSplitter*>())
+            candidates << splitter;
+        foreach (QAbstractToolWindowManagerArea *area, m_areas)
+            if (area->topLevelWidget() == topLevel)
+                candidates << area;
+        foreach (QWidget *widget, candidates) {
+            QSplitter *splitter = qobject_cast<QSplitter*>(widget);
+            QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea *>(widget);
+            if (!splitter && !area) {
+                qWarning("unexpected widget type");
+                continue;
+            }
+            QSplitter *parentSplitter = qobject_cast<QSplitter*>(widget->parentWidget());
+            bool lastInSplitter = parentSplitter &&
+                    parentSplitter->indexOf(widget) == parentSplitter->count() - 1;
+
+            bool allowedSides[DropTarget::SideCount];
+            allowedSides[0] = !splitter || splitter->orientation() == Qt::Vertical;
+            allowedSides[1] = !splitter || splitter->orientation() == Qt::Horizontal;
+            allowedSides[2] = (!parentSplitter || parentSplitter->orientation() == Qt::Vertical ||
+                               lastInSplitter) && allowedSides[0];
+            allowedSides[3] = (!parentSplitter || parentSplitter->orientation() == Qt::Horizontal ||
+                               lastInSplitter) && allowedSides[1];
+
+            DropTarget target;
+            target.widget = widget;
+            target.isArea = area != 0;
+            QPoint offset = widget->mapTo(topLevel, QPoint(0, 0));
+            target.rect = widget->rect().translated(offset);
+            for (int i = 0; i < DropTarget::SideCount; i++) {
+                if (allowedSides[i])
+                    target.sideRects[i] = sideSensitiveArea(widget, dropTargetSides[i]).translated(offset);
+            }
+            m_dropTargets << target;
+        }
+        dropWrapper.targetCount = m_dropTargets.count() - dropWrapper.firstTarget;
+        m_dropWrappers << dropWrapper;
+    }
+    m_dropTargetsValid = true;
+    updateDropWrapperGeometry();
+}
+
+static bool dropWrapperZOrderLessThan(const QToolWindowManagerPrivate::DropWrapper &a,
+                                      const QToolWindowManagerPrivate::DropWrapper &b)
+{
+    return a.zOrder < b.zOrder;
+}
+
+void QToolWindowManagerPrivate::updateDropWrapperGeometry()
+{
+    Q_Q(QToolWindowManager);
+    QWidget *mainWindow = q->window();
+    for (int i = 0; i < m_dropWrappers.count(); i++) {
+        DropWrapper &dropWrapper = m_dropWrappers[i];
+        dropWrapper.globalRect = dropWrapper.rect.translated(dropWrapper.topLevel->mapToGlobal(QPoint(0, 0)));
+        // Floating wrappers are tool windows and always stay above the main window.
+        // Floating wrappers that have never been activated are placed below other ones.
+        if (dropWrapper.topLevel == mainWindow) {
+            dropWrapper.zOrder = INT_MAX;
+        } else {
+            int zOrder = m_topLevelOrder.indexOf(dropWrapper.topLevel);
+            dropWrapper.zOrder = zOrder < 0 ? m_topLevelOrder.count() : zOrder;
+        }
+    }
+    qStableSort(m_dropWrappers.begin(), m_dropWrappers.end(), dropWrapperZOrderLessThan);
+    m_dropWrapperGeometryValid = true;
+}
+
+void QToolWindowManagerPrivate::topLevelActivated(QWidget *topLevel)
+{
+    for (int i = 0; i < m_topLevelOrder.count(); i++) {
+        if (!m_topLevelOrder[i] || m_topLevelOrder[i] == topLevel)
+            m_topLevelOrder.removeAt(i--);
+    }
+    m_topLevelOrder.prepend(topLevel);
+    invalidateDropWrapperGeometry();
+}
+
 void QToolWindowManagerPrivate::findSuggestions(QToolWindowManagerWrapper *wrapper)
 {
-    m_suggestions.clear();
-    m_dropCurrentSuggestionIndex = -1;
-    QPoint globalPos = QCursor::pos();
-    QWidgetList candidates;
-    foreach (QSplitter *splitter, wrapper->findChildren<QSplitter*>())
-        candidates << splitter;
-    foreach (QAbstractToolWindowManagerArea *area, m_areas)
-        if (area->topLevelWidget() == wrapper->topLevelWidget())
-            candidates << area;
-    foreach (QWidget *widget, candidates) {
-        QSplitter *splitter = qobject_cast<QSplitter*>(widget);
-        QAbstractToolWindowManagerArea *area = qobject_cast<QAbstractToolWindowManagerArea *>(widget);
-        if (!splitter && !area) {
-            qWarning("unexpected widget type");
-            continue;
+    QToolWindowManagerTraceScope trace(&m_trace, "findSuggestions", m_dropTargets.count());
+    if (!m_dropTargetsValid)
+        buildDropTargets();
+    const DropWrapper *dropWrapper = 0;
+    for (int i = 0; i < m_dropWrappers.count(); i++) {
+        if (m_dropWrappers[i].wrapper == wrapper) {
+            dropWrapper = &m_dropWrappers[i];
+            break;
         }
-        QSplitter *parentSplitter = qobject_cast<QSplitter*>(widget->parentWidget());
-        bool lastInSplitter = parentSplitter &&
-                parentSplitter->indexOf(widget) == parentSplitter->count() - 1;
-
-        QList<QToolWindowManager::ReferenceType> allowedSides;
-        if (!splitter || splitter->orientation() == Qt::Vertical)
-            allowedSides << QToolWindowManager::ReferenceLeftOf;
-        if (!splitter || splitter->orientation() == Qt::Horizontal)
-            allowedSides << QToolWindowManager::ReferenceTopOf;
-        if (!parentSplitter || parentSplitter->orientation() == Qt::Vertical || lastInSplitter)
-            if (!splitter || splitter->orientation() == Qt::Vertical)
-                allowedSides << QToolWindowManager::ReferenceRightOf;
-        if (!parentSplitter || parentSplitter->orientation() == Qt::Horizontal || lastInSplitter)
-            if (!splitter || splitter->orientation() == Qt::Horizontal)
-                allowedSides << QToolWindowManager::ReferenceBottomOf;
-        foreach (QToolWindowManager::ReferenceType side, allowedSides)
-            if (sideSensitiveArea(widget, side).contains(widget->mapFromGlobal(globalPos)))
-                m_suggestions << QToolWindowManagerAreaReference(side, widget);
-        if (area && area->rect().contains(area->mapFromGlobal(globalPos)))
-            m_suggestions << QToolWindowManagerAreaReference(QToolWindowManager::ReferenceAddTo, area);
-    }
-    if (candidates.isEmpty())
-        m_suggestions << QToolWindowManager::EmptySpaceArea;
-
-    if (m_suggestions.isEmpty())
+    }
+    if (!dropWrapper) {
         handleNoSuggestions();
-    else
-        showNextDropSuggestion();
+        return;
+    }
+    // resize() keeps allocated memory unlike clear() in old Qt versions
+    QVector<QToolWindowManagerAreaReference> &suggestions = m_suggestionBuffer;
+    suggestions.resize(0);
+    QPoint pos = dropWrapper->topLevel->mapFromGlobal(QCursor::pos());
+    int lastTarget = dropWrapper->firstTarget + dropWrapper->targetCount;
+    for (int i = dropWrapper->firstTarget; i < lastTarget; i++) {
+        const DropTarget &target = m_dropTargets[i];
+        for (int side = 0; side < DropTarget::SideCount; side++)
+            if (target.sideRects[side].contains(pos))
+                suggestions << QToolWindowManagerAreaReference(dropTargetSides[side], target.widget);
+        if (target.isArea && target.rect.contains(pos))
+            suggestions << QToolWindowManagerAreaReference(QToolWindowManager::ReferenceAddTo, target.widget);
+    }
+    if (dropWrapper->targetCount == 0)
+        suggestions << QToolWindowManager::EmptySpaceArea;
+    applySuggestionBuffer();
 }
 
 QRect QToolWindowManagerPrivate::sideSensitiveArea(QWidget *widget,
@@ -1019,10 +2696,17 @@ QRect QToolWindowManagerPrivate::sidePlaceHolderRect(QWidget *widget,
     return QRect();
 }
 
+void QToolWindowManagerPrivate::scheduleDragPositionUpdate()
+{
+    if (dragInProgress())
+        m_dragPositionDirty = true;
+}
+
 void QToolWindowManagerPrivate::updateDragPosition()
 {
     if (!dragInProgress())
         return;
+    m_dragPositionDirty = false;
     if (!(qApp->mouseButtons() & Qt::LeftButton)) {
         finishDrag();
         return;
@@ -1032,19 +2716,20 @@ void QToolWindowManagerPrivate::updateDragPosition()
     m_dragIndicator->move(pos + QPoint(1, 1));
     bool foundWrapper = false;
 
-    QWidget *window = qApp->topLevelAt(pos);
-    foreach (QToolWindowManagerWrapper *wrapper, m_wrappers) {
-        if (wrapper->window() == window) {
-            if (wrapper->rect().contains(wrapper->mapFromGlobal(pos))) {
-                findSuggestions(wrapper);
-                if (!m_suggestions.isEmpty()) {
-                    //starting or restarting timer
-                    if (m_dropSuggestionSwitchTimer.isActive())
-                        m_dropSuggestionSwitchTimer.stop();
-                    m_dropSuggestionSwitchTimer.start();
-                    foundWrapper = true;
-                }
-            }
+    // The wrapper under the cursor is found using geometry and stacking order snapshotted
+    // at drag start, which is much cheaper than QApplication::topLevelAt. Stacking order
+    // is approximated by the order of activation.
+    if (!m_dropTargetsValid)
+        buildDropTargets();
+    else if (!m_dropWrapperGeometryValid)
+        updateDropWrapperGeometry();
+    for (int i = 0; i < m_dropWrappers.count(); i++) {
+        const DropWrapper &dropWrapper = m_dropWrappers[i];
+        if (!dropWrapper.topLevel->isVisible() || dropWrapper.topLevel->isMinimized())
+            continue;
+        if (dropWrapper.globalRect.contains(pos)) {
+            findSuggestions(dropWrapper.wrapper);
+            foundWrapper = !m_suggestions.isEmpty();
             break;
         }
     }
@@ -1058,11 +2743,18 @@ void QToolWindowManagerPrivate::finishDrag()
         qWarning("unexpected finishDrag");
         return;
     }
+    beginTransaction();
+    qApp->removeEventFilter(&m_dragFilter);
+    m_dragUpdateTimer.stop();
+    m_dragPositionDirty = false;
+    if (QWidget::mouseGrabber() == m_dragIndicator)
+        m_dragIndicator->releaseMouse();
     if (m_suggestions.isEmpty()) {
         moveToolWindows(m_draggedToolWindows, QToolWindowManager::NewFloatingArea);
     } else {
         if (m_dropCurrentSuggestionIndex >= m_suggestions.count()) {
             qWarning("invalid m_dropCurrentSuggestionIndex");
+            commitTransaction();
             return;
         }
         QToolWindowManagerAreaReference suggestion = m_suggestions[m_dropCurrentSuggestionIndex];
@@ -1070,15 +2762,24 @@ void QToolWindowManagerPrivate::finishDrag()
         moveToolWindows(m_draggedToolWindows, suggestion);
     }
     m_dragIndicator->hide();
+    hideOverlays();
     m_draggedToolWindows.clear();
+    invalidateDropTargets();
+    commitTransaction();
 }
 
 
 QAbstractToolWindowManagerArea *QToolWindowManagerPrivate::createAndSetupArea() {
     Q_Q(QToolWindowManager);
-    QAbstractToolWindowManagerArea *area = q->createArea();
-    QObject::connect(area, SIGNAL(destroyed(QObject*)),
-                     &slots_object, SLOT(areaDestroyed(QObject*)));
+    QAbstractToolWindowManagerArea *area = 0;
+    while (!area && !m_areaPool.isEmpty())
+        area = m_areaPool.takeLast();
+    if (!area) {
+        area = q->createArea();
+        QObject::connect(area, SIGNAL(destroyed(QObject*)),
+                         &slots_object, SLOT(areaDestroyed(QObject*)));
+        m_layoutWidgets << area;
+    }
     m_areas << area;
     return area;
 }
@@ -1093,8 +2794,20 @@ QAbstractToolWindowManagerArea *QToolWindowManager::createArea() {
 QSplitter *QToolWindowManagerPrivate::createAndSetupSplitter()
 {
     Q_Q(QToolWindowManager);
-    //currently no setup here
-    return q->createSplitter();
+    while (!m_splitterPool.isEmpty()) {
+        QSplitter *splitter = m_splitterPool.takeLast();
+        if (splitter)
+            return splitter;
+    }
+    QSplitter *splitter = q->createSplitter();
+    QObject::connect(splitter, SIGNAL(splitterMoved(int,int)),
+                     &slots_object, SLOT(splitterMoved()));
+    QObject::connect(splitter, SIGNAL(destroyed(QObject*)),
+                     &slots_object, SLOT(splitterDestroyed(QObject*)));
+    m_layoutWidgets << splitter;
+    // items and size changes invalidate the saved state of the splitter
+    splitter->installEventFilter(&slots_object);
+    return splitter;
 }
 
 QToolWindowManagerAreaReference::QToolWindowManagerAreaReference(QToolWindowManager::AreaType type)
@@ -1124,6 +2837,32 @@ QToolWindowManagerAreaReference::QToolWindowManagerAreaReference(QToolWindowMana
 */
 bool QToolWindowManager::event(QEvent *e)
 {
+    Q_D(QToolWindowManager);
+    switch (e->type()) {
+    case QEvent::Show:
+    case QEvent::ParentChange:
+        // minimizing the window containing the manager changes exposure of tool windows
+        if (d->m_exposureWindow != window()) {
+            if (d->m_exposureWindow)
+                d->m_exposureWindow->removeEventFilter(&(d->slots_object));
+            d->m_exposureWindow = window();
+            if (d->m_exposureWindow != this)
+                d->m_exposureWindow->installEventFilter(&(d->slots_object));
+        }
+        d->scheduleExposureUpdate(this);
+        break;
+    case QEvent::Hide:
+    case QEvent::WindowStateChange:
+        d->scheduleExposureUpdate(this);
+        break;
+    case QEvent::Move:
+        // the filter on the window containing the manager handles other cases
+        if (isWindow())
+            d->invalidateDropWrapperGeometry();
+        break;
+    default:
+        break;
+    }
     return QWidget::event(e);
 }
 
@@ -1141,6 +2880,130 @@ void QToolWindowManagerPrivateSlots::areaDestroyed(QObject *object)
     if (area == d->m_lastUsedArea)
         d->m_lastUsedArea = 0;
     d->m_areas.removeOne(area);
+    d->m_layoutWidgets.remove(area);
+    d->m_exposureChangedWidgetsSet.remove(area);
+    d->m_savedStateCache.remove(area);
+    d->m_capturedStateCache.remove(area);
+    d->invalidateDropTargets();
+    // the area may have been the implicit mouse grabber of the current drag
+    if (d->dragInProgress() && d->m_dragIndicator->isVisible() && !QWidget::mouseGrabber())
+        d->m_dragIndicator->grabMouse();
+}
+
+void QToolWindowManagerPrivateSlots::splitterDestroyed(QObject *object)
+{
+    d->m_layoutWidgets.remove(static_cast<QSplitter *>(object));
+}
+
+void QToolWindowManagerPrivateSlots::updateToolWindowsMetadata()
+{
+    d->updateToolWindowsMetadata();
+}
+
+void QToolWindowManagerPrivateSlots::toolWindowMetadataChanged()
+{
+    if (QWidget *toolWindow = qobject_cast<QWidget*>(sender()))
+        d->toolWindowMetadataChanged(toolWindow);
+}
+
+void QToolWindowManagerPrivateSlots::toolWindowNameChanged()
+{
+    if (QWidget *toolWindow = qobject_cast<QWidget*>(sender()))
+        d->toolWindowNameChanged(toolWindow);
+}
+
+void QToolWindowManagerPrivateSlots::autoSave()
+{
+    d->autoSave();
+}
+
+void QToolWindowManagerPrivateSlots::scheduleAutoSave()
+{
+    d->scheduleAutoSave();
+}
+
+void QToolWindowManagerPrivateSlots::splitterMoved()
+{
+    d->invalidateSavedState(qobject_cast<QSplitter*>(sender()));
+    d->scheduleAutoSave();
+}
+
+void QToolWindowManagerPrivateSlots::updateExposure()
+{
+    d->updateExposure();
+}
+
+void QToolWindowManagerPrivateSlots::updateDragPosition()
+{
+    if (d->m_dragPositionDirty)
+        d->updateDragPosition();
+}
+
+void QToolWindowManagerPrivateSlots::createPendingToolWindows()
+{
+    QList<QPointer<QWidget> > placeholders = d->m_pendingPlaceholders;
+    d->m_pendingPlaceholders.clear();
+    foreach (QWidget *placeholder, placeholders) {
+        // the placeholder may have been hidden again in the meantime
+        if (placeholder && placeholder->isVisible())
+            d->createToolWindow(placeholder);
+    }
+}
+
+bool QToolWindowManagerPrivateSlots::eventFilter(QObject *object, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::Show:
+        if (object->isWidgetType()) {
+            QWidget *widget = static_cast<QWidget*>(object);
+            const QToolWindowManagerPrivate::ToolWindowData *data = d->toolWindowData(widget);
+            if (data && !data->factoryMethod.isEmpty())
+                d->placeholderShown(widget);
+        }
+        break;
+    case QEvent::WindowStateChange:
+        if (object == d->m_exposureWindow)
+            d->scheduleExposureUpdate(d->m_exposureWindow);
+        break;
+    case QEvent::ChildAdded:
+    case QEvent::ChildRemoved:
+    case QEvent::Resize:
+        if (QSplitter *splitter = qobject_cast<QSplitter*>(object))
+            d->invalidateSavedState(splitter);
+        break;
+    case QEvent::Move:
+        // global geometry of drop targets is affected only by moving top levels
+        if (object == d->m_exposureWindow)
+            d->invalidateDropWrapperGeometry();
+        break;
+#if QT_VERSION < 0x050200
+    case QEvent::WindowTitleChange:
+    case QEvent::WindowIconChange:
+#endif
+    case QEvent::ToolTipChange:
+        if (object->isWidgetType() && d->toolWindowData(static_cast<QWidget*>(object)))
+            d->toolWindowMetadataChanged(static_cast<QWidget*>(object));
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(object, event);
+}
+
+bool QToolWindowManagerDragFilter::eventFilter(QObject *object, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::MouseMove:
+        d->scheduleDragPositionUpdate();
+        break;
+    case QEvent::MouseButtonRelease:
+        // finishes the drag immediately if the left button has been released
+        d->updateDragPosition();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(object, event);
 }
 
 #endif // QT_NO_TOOLWINDOWMANAGER
@@ -90,11 +90,34 @@ class QAbstractToolWindowManagerArea;
 class QToolWindowManagerPrivate;
 class QSplitter;
 class QRubberBand;
+class QIODevice;
+class QToolWindowManagerState;
+
+struct QToolWindowManagerStatistics
+{
+    QToolWindowManagerStatistics() :
+        areaCount(0), splitterCount(0), wrapperCount(0),
+        pooledAreaCount(0), pooledSplitterCount(0), pooledWrapperCount(0),
+        pendingDeletionCount(0), maxSplitterDepth(0), widgetCount(0),
+        unreachableCount(0), approximateBytes(0) {}
+
+    int areaCount;
+    int splitterCount;
+    int wrapperCount;
+    int pooledAreaCount;
+    int pooledSplitterCount;
+    int pooledWrapperCount;
+    int pendingDeletionCount;
+    int maxSplitterDepth;
+    int widgetCount;
+    int unreachableCount;
+    qint64 approximateBytes;
+};
 
 class QTOOLWINDOWMANAGER_EXPORT QToolWindowManager : public QWidget
 {
     Q_OBJECT
-    Q_ENUMS(AreaType ReferenceType)
+    Q_ENUMS(AreaType ReferenceType ExposureState)
     Q_PROPERTY(int suggestionSwitchInterval READ suggestionSwitchInterval
                                             WRITE setSuggestionSwitchInterval
                                             NOTIFY suggestionSwitchIntervalChanged)
@@ -107,6 +130,18 @@ class QTOOLWINDOWMANAGER_EXPORT QToolWindowManager : public QWidget
     Q_PROPERTY(bool tabsClosable READ tabsClosable
                                  WRITE setTabsClosable
                                  NOTIFY tabsClosableChanged)
+    Q_PROPERTY(int dragPixmapTabLimit READ dragPixmapTabLimit
+                                      WRITE setDragPixmapTabLimit
+                                      NOTIFY dragPixmapTabLimitChanged)
+    Q_PROPERTY(int recyclePoolSize READ recyclePoolSize
+                                   WRITE setRecyclePoolSize
+                                   NOTIFY recyclePoolSizeChanged)
+    Q_PROPERTY(QString autoSaveFileName READ autoSaveFileName
+                                        WRITE setAutoSaveFileName
+                                        NOTIFY autoSaveFileNameChanged)
+    Q_PROPERTY(int autoSaveInterval READ autoSaveInterval
+                                    WRITE setAutoSaveInterval
+                                    NOTIFY autoSaveIntervalChanged)
 
 public:
     explicit QToolWindowManager(QWidget *parent = 0);
@@ -127,6 +162,13 @@ public:
         ReferenceBottomOf
     };
 
+    enum ExposureState {
+        ToolWindowExposed,
+        ToolWindowObscuredByTab,
+        ToolWindowHidden,
+        ToolWindowMinimized
+    };
+
     void addToolWindow(QWidget *toolWindow, AreaType area = LastUsedArea);
     void addToolWindow(QWidget *toolWindow, ReferenceType reference,
                        QAbstractToolWindowManagerArea *area);
@@ -134,6 +176,12 @@ public:
     void addToolWindows(const QWidgetList &toolWindows, ReferenceType reference,
                        QAbstractToolWindowManagerArea *area);
 
+    QWidget *addToolWindowFactory(const QString &name, const QString &title, const QIcon &icon,
+                                  QObject *receiver, const char *member,
+                                  AreaType area = NoArea);
+    bool isToolWindowCreated(QWidget *toolWindow) const;
+    QWidget *createToolWindow(QWidget *placeholder);
+
     void moveToolWindow(QWidget *toolWindow, AreaType area = LastUsedArea);
     void moveToolWindow(QWidget *toolWindow, ReferenceType reference,
                        QAbstractToolWindowManagerArea *area);
@@ -142,11 +190,23 @@ public:
                        QAbstractToolWindowManagerArea *area);
 
     QAbstractToolWindowManagerArea *areaFor(QWidget *toolWindow) const;
+    ExposureState toolWindowExposure(QWidget *toolWindow) const;
     void removeToolWindow(QWidget *toolWindow);
     QWidgetList toolWindows() const;
     void hideToolWindow(QWidget *toolWindow);
     QVariant saveState() const;
     void restoreState(const QVariant& data);
+    bool saveState(QIODevice *device) const;
+    bool restoreState(QIODevice *device);
+    bool restoreState(const QToolWindowManagerState &state);
+
+    bool saveTrace(QIODevice *device) const;
+    void clearTrace();
+
+    QToolWindowManagerStatistics statistics() const;
+
+    void beginLayoutTransaction();
+    void commitLayoutTransaction();
 
     int suggestionSwitchInterval() const;
     void setSuggestionSwitchInterval(int msec);
@@ -160,6 +220,20 @@ public:
     bool tabsClosable() const;
     void setTabsClosable(bool enabled);
 
+    int dragPixmapTabLimit() const;
+    void setDragPixmapTabLimit(int count);
+
+    int recyclePoolSize() const;
+    void setRecyclePoolSize(int size);
+
+    QString autoSaveFileName() const;
+    void setAutoSaveFileName(const QString &fileName);
+
+    int autoSaveInterval() const;
+    void setAutoSaveInterval(int msec);
+
+    bool flushAutoSave();
+
     QRubberBand *rectRubberBand() const;
     QRubberBand *lineRubberBand() const;
 
@@ -167,10 +241,16 @@ public:
 
 Q_SIGNALS:
     void toolWindowVisibilityChanged(QWidget *toolWindow, bool visible);
+    void toolWindowCreated(QWidget *placeholder, QWidget *toolWindow);
+    void toolWindowExposureChanged(QWidget *toolWindow, QToolWindowManager::ExposureState state);
     void suggestionSwitchIntervalChanged(int suggestionSwitchInterval);
     void borderSensitivityChanged(int borderSensitivity);
     void rubberBandLineWidthChanged(int rubberBandLineWidth);
     void tabsClosableChanged(bool tabsClosable);
+    void dragPixmapTabLimitChanged(int dragPixmapTabLimit);
+    void recyclePoolSizeChanged(int recyclePoolSize);
+    void autoSaveFileNameChanged(const QString &autoSaveFileName);
+    void autoSaveIntervalChanged(int autoSaveInterval);
 
 protected:
     virtual QSplitter * createSplitter();
@@ -188,6 +268,24 @@ private:
     friend class QToolWindowManagerArea;
 };
 
+class QToolWindowManagerLayoutTransaction
+{
+public:
+    explicit QToolWindowManagerLayoutTransaction(QToolWindowManager *manager) :
+        m_manager(manager)
+    {
+        m_manager->beginLayoutTransaction();
+    }
+    ~QToolWindowManagerLayoutTransaction()
+    {
+        m_manager->commitLayoutTransaction();
+    }
+
+private:
+    Q_DISABLE_COPY(QToolWindowManagerLayoutTransaction)
+    QToolWindowManager *m_manager;
+};
+
 #endif // QT_NO_TOOLWINDOWMANAGER
 
 QT_END_NAMESPACE
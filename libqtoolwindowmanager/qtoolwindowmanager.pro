@@ -8,14 +8,21 @@ OTHER_FILES += \
 HEADERS += \
     qabstracttoolwindowmanagerarea.h \
     qtoolwindowmanager.h \
+    qtoolwindowmanagerstate.h \
     private/qtoolwindowmanagerarea_p.h \
     private/qtoolwindowmanager_p.h \
+    private/qtoolwindowmanageroverlay_p.h \
+    private/qtoolwindowmanagerstate_p.h \
+    private/qtoolwindowmanagertrace_p.h \
     private/qtoolwindowmanagerwrapper_p.h
 
 SOURCES += \
     qabstracttoolwindowmanagerarea.cpp \
     qtoolwindowmanager.cpp \
     qtoolwindowmanagerarea.cpp \
+    qtoolwindowmanageroverlay.cpp \
+    qtoolwindowmanagerstate.cpp \
+    qtoolwindowmanagertrace.cpp \
     qtoolwindowmanagerwrapper.cpp
 
 DEFINES += QTOOLWINDOWMANAGER_BUILD_LIB
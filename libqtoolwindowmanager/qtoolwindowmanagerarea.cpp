@@ -104,6 +104,10 @@ QToolWindowManagerArea::QToolWindowManagerArea(QToolWindowManager *manager) :
     d->m_tabWidget->setTabsClosable(d->m_d_manager->m_tabsClosable);
     connect(d->m_manager, SIGNAL(tabsClosableChanged(bool)),
             this, SLOT(managerTabsClosableChanged(bool)));
+    connect(d->m_tabWidget, SIGNAL(currentChanged(int)),
+            this, SLOT(tabWidgetCurrentChanged()));
+    connect(d->m_tabWidget->tabBar(), SIGNAL(tabMoved(int,int)),
+            this, SLOT(tabBarTabMoved()));
     d->m_tabWidget->setDocumentMode(true);
     d->m_tabWidget->tabBar()->installEventFilter(this);
 }
@@ -124,7 +128,6 @@ void QToolWindowManagerArea::mouseReleaseEvent(QMouseEvent *)
 {
     Q_D(QToolWindowManagerArea);
     d->m_dragCanStart = false;
-    updateDragPosition();
 }
 
 void QToolWindowManagerArea::mouseMoveEvent(QMouseEvent *)
@@ -150,24 +153,22 @@ bool QToolWindowManagerArea::eventFilter(QObject *object, QEvent *event)
         case QEvent::MouseButtonRelease:
             d->m_tabDragCanStart = false;
             d->m_dragCanStart = false;
-            updateDragPosition();
             break;
         case QEvent::MouseMove:
-            updateDragPosition();
             if (d->m_tabDragCanStart) {
                 if (d->m_tabWidget->tabBar()->rect().contains(static_cast<QMouseEvent*>(event)->pos()))
                     return false;
                 if (qApp->mouseButtons() != Qt::LeftButton)
                     return false;
                 QWidget *toolWindow = d->m_tabWidget->currentWidget();
-                if (!toolWindow || !d->m_manager->toolWindows().contains(toolWindow))
+                if (!toolWindow || !d->m_d_manager->toolWindowData(toolWindow))
                     return false;
                 d->m_tabDragCanStart = false;
                 //stop internal tab drag in QTabBar
-                QMouseEvent *releaseEvent = new QMouseEvent(QEvent::MouseButtonRelease,
-                                                            static_cast<QMouseEvent*>(event)->pos(),
-                                                            Qt::LeftButton, Qt::LeftButton, 0);
-                qApp->sendEvent(d->m_tabWidget->tabBar(), releaseEvent);
+                QMouseEvent releaseEvent(QEvent::MouseButtonRelease,
+                                         static_cast<QMouseEvent*>(event)->pos(),
+                                         Qt::LeftButton, Qt::LeftButton, 0);
+                qApp->sendEvent(d->m_tabWidget->tabBar(), &releaseEvent);
                 startDrag(QWidgetList() << toolWindow);
             } else if (d->m_dragCanStart) {
                 d->check_mouse_move();
@@ -177,12 +178,6 @@ bool QToolWindowManagerArea::eventFilter(QObject *object, QEvent *event)
             break;
         }
     }
-    if (event->type() == QEvent::WindowTitleChange) {
-        int index = d->m_tabWidget->indexOf(static_cast<QWidget*>(object));
-        if (index >= 0) {
-            d->m_tabWidget->setTabText(index, d->m_tabWidget->widget(index)->windowTitle());
-        }
-    }
     return QAbstractToolWindowManagerArea::eventFilter(object, event);
 }
 
@@ -193,19 +188,22 @@ void QToolWindowManagerArea::releaseTabButtons(QWidget* toolWindow) {
         qWarning("unexpected indexOf fail");
         return;
     }
-    if (d->m_d_manager->m_toolWindowData[toolWindow].leftButtonWidget) {
+    const QToolWindowManagerPrivate::ToolWindowData *data = d->m_d_manager->toolWindowData(toolWindow);
+    if (!data)
+        return;
+    if (data->leftButtonWidget) {
         d->m_tabWidget->tabBar()->setTabButton(
               index,
               QTabBar::LeftSide,
               0);
-        d->m_d_manager->m_toolWindowData[toolWindow].leftButtonWidget->setParent(d->m_manager);
+        data->leftButtonWidget->setParent(d->m_manager);
     }
-    if (d->m_d_manager->m_toolWindowData[toolWindow].rightButtonWidget) {
+    if (data->rightButtonWidget) {
         d->m_tabWidget->tabBar()->setTabButton(
               index,
               QTabBar::RightSide,
               0);
-        d->m_d_manager->m_toolWindowData[toolWindow].rightButtonWidget->setParent(d->m_manager);
+        data->rightButtonWidget->setParent(d->m_manager);
     }
 
 }
@@ -218,17 +216,20 @@ void QToolWindowManagerArea::applyTabButtons(QWidget* toolWindow)
         qWarning("unexpected indexOf fail");
         return;
     }
-    if (d->m_d_manager->m_toolWindowData[toolWindow].leftButtonWidget) {
+    const QToolWindowManagerPrivate::ToolWindowData *data = d->m_d_manager->toolWindowData(toolWindow);
+    if (!data)
+        return;
+    if (data->leftButtonWidget) {
         d->m_tabWidget->tabBar()->setTabButton(
               index,
               QTabBar::LeftSide,
-              d->m_d_manager->m_toolWindowData[toolWindow].leftButtonWidget);
+              data->leftButtonWidget);
     }
-    if (d->m_d_manager->m_toolWindowData[toolWindow].rightButtonWidget) {
+    if (data->rightButtonWidget) {
         d->m_tabWidget->tabBar()->setTabButton(
               index,
               QTabBar::RightSide,
-              d->m_d_manager->m_toolWindowData[toolWindow].rightButtonWidget);
+              data->rightButtonWidget);
     }
 }
 
@@ -241,7 +242,6 @@ void QToolWindowManagerArea::managerTabsClosableChanged(bool enabled)
 void QToolWindowManagerAreaPrivate::check_mouse_move()
 {
     Q_Q(QToolWindowManagerArea);
-    q->updateDragPosition();
     if (qApp->mouseButtons() == Qt::LeftButton &&
             !q->rect().contains(q->mapFromGlobal(QCursor::pos())) &&
             m_dragCanStart) {
@@ -284,10 +284,12 @@ void QToolWindowManagerArea::addToolWindows(const QWidgetList &toolWindows)
     int index = 0;
     foreach (QWidget *toolWindow, toolWindows) {
         index = d->m_tabWidget->addTab(toolWindow, toolWindow->windowIcon(), toolWindow->windowTitle());
+        d->m_tabWidget->setTabToolTip(index, toolWindow->toolTip());
         applyTabButtons(toolWindow);
-        toolWindow->installEventFilter(this);
     }
-    d->m_tabWidget->setCurrentIndex(index);
+    // the current tab of a restored area is set once by restoreState
+    if (!d->m_d_manager->m_restoringState)
+        d->m_tabWidget->setCurrentIndex(index);
 }
 
 void QToolWindowManagerArea::removeToolWindow(QWidget *toolWindow)
@@ -300,7 +302,43 @@ void QToolWindowManagerArea::removeToolWindow(QWidget *toolWindow)
     }
     releaseTabButtons(toolWindow);
     d->m_tabWidget->removeTab(index);
-    toolWindow->removeEventFilter(this);
+}
+
+void QToolWindowManagerArea::replaceToolWindow(QWidget *oldToolWindow, QWidget *newToolWindow)
+{
+    Q_D(QToolWindowManagerArea);
+    int index = d->m_tabWidget->indexOf(oldToolWindow);
+    if (index < 0) {
+        qWarning("QToolWindowManagerArea::replaceToolWindow: no such tool window");
+        return;
+    }
+    bool current = d->m_tabWidget->currentIndex() == index;
+    releaseTabButtons(oldToolWindow);
+    d->m_tabWidget->removeTab(index);
+    d->m_tabWidget->insertTab(index, newToolWindow, newToolWindow->windowIcon(),
+                              newToolWindow->windowTitle());
+    d->m_tabWidget->setTabToolTip(index, newToolWindow->toolTip());
+    applyTabButtons(newToolWindow);
+    if (current)
+        d->m_tabWidget->setCurrentIndex(index);
+}
+
+void QToolWindowManagerArea::toolWindowsChanged(const QWidgetList &toolWindows)
+{
+    Q_D(QToolWindowManagerArea);
+    foreach (QWidget *toolWindow, toolWindows) {
+        int index = d->m_tabWidget->indexOf(toolWindow);
+        if (index < 0)
+            continue;
+        // changing the text relayouts the tab bar, so it's avoided if possible
+        if (d->m_tabWidget->tabText(index) != toolWindow->windowTitle())
+            d->m_tabWidget->setTabText(index, toolWindow->windowTitle());
+        QIcon icon = toolWindow->windowIcon();
+        if (d->m_tabWidget->tabIcon(index).cacheKey() != icon.cacheKey())
+            d->m_tabWidget->setTabIcon(index, icon);
+        if (d->m_tabWidget->tabToolTip(index) != toolWindow->toolTip())
+            d->m_tabWidget->setTabToolTip(index, toolWindow->toolTip());
+    }
 }
 
 QVariant QToolWindowManagerArea::saveState() const
@@ -317,6 +355,22 @@ void QToolWindowManagerArea::restoreState(const QVariant &state)
     d->m_tabWidget->setCurrentIndex(state.toMap()[QLatin1String("currentIndex")].toInt());
 }
 
+void QToolWindowManagerArea::tabWidgetCurrentChanged()
+{
+    Q_D(QToolWindowManagerArea);
+    updateToolWindowExposure();
+    // the current tab is a part of the saved state
+    d->m_d_manager->invalidateSavedState(this);
+    d->m_d_manager->scheduleAutoSave();
+}
+
+void QToolWindowManagerArea::tabBarTabMoved()
+{
+    Q_D(QToolWindowManagerArea);
+    d->m_d_manager->invalidateSavedState(this);
+    d->m_d_manager->scheduleAutoSave();
+}
+
 void QToolWindowManagerArea::beforeTabButtonChanged(QWidget* toolWindow)
 {
     releaseTabButtons(toolWindow);
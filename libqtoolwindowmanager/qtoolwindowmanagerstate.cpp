@@ -0,0 +1,554 @@
+/****************************************************************************
+**
+** Copyright (C) 2014 Pavel Strakhov <ri@idzaaus.org>
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+**
+** Copyright (C) 2014 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtWidgets module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <qtoolwindowmanagerstate.h>
+#include <qbuffer.h>
+#include <qdatastream.h>
+#include <qendian.h>
+#include <qhash.h>
+#include <qiodevice.h>
+#include <qset.h>
+#include <private/qtoolwindowmanagerstate_p.h>
+
+QT_BEGIN_NAMESPACE
+
+#ifndef QT_NO_TOOLWINDOWMANAGER
+
+/*!
+    \class QToolWindowManagerState
+
+    \brief The QToolWindowManagerState class holds a parsed and validated layout
+    of QToolWindowManager.
+
+    Restoring a saved layout consists of two phases: parsing and validating the saved data,
+    and changing the widgets. QToolWindowManagerState performs the first phase only and
+    doesn't depend on any widget, so it may be created in a worker thread, e.g. while the
+    application shows a splash screen, and passed to QToolWindowManager::restoreState
+    in the GUI thread later. Invalid data is rejected before anything on the screen changes.
+
+    Area data returned by QAbstractToolWindowManagerArea::saveState is kept as QVariant,
+    so it must not contain GUI types (like QPixmap) if the state is parsed outside the GUI thread.
+
+    QToolWindowManagerState is implicitly shared.
+
+    \inmodule QtWidgets
+
+    \since 5.4
+ */
+
+/*! Constructs an invalid state. */
+QToolWindowManagerState::QToolWindowManagerState() :
+    d(new QToolWindowManagerStatePrivate)
+{
+}
+
+/*! Constructs a copy of \a other. */
+QToolWindowManagerState::QToolWindowManagerState(const QToolWindowManagerState &other) :
+    d(other.d)
+{
+}
+
+/*! Destroys the state. */
+QToolWindowManagerState::~QToolWindowManagerState()
+{
+}
+
+/*! Assigns \a other to this state. */
+QToolWindowManagerState &QToolWindowManagerState::operator=(const QToolWindowManagerState &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+ * Parses \a data returned by QToolWindowManager::saveState(). A QByteArray containing
+ * the state written by QToolWindowManager::saveState(QIODevice*) is also accepted.
+ */
+QToolWindowManagerState QToolWindowManagerState::fromVariant(const QVariant &data)
+{
+    QToolWindowManagerState result;
+    QToolWindowManagerStatePrivate *d = result.d.data();
+    if (data.type() == QVariant::ByteArray) {
+        QByteArray bytes = data.toByteArray();
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::ReadOnly);
+        d->valid = QToolWindowManagerStatePrivate::read(&buffer, d->data, &d->errorString);
+    } else {
+        d->valid = QToolWindowManagerStatePrivate::parse(data.toMap(), d->data, &d->errorString);
+    }
+    if (d->valid)
+        d->valid = QToolWindowManagerStatePrivate::validate(d->data, &d->errorString);
+    return result;
+}
+
+/*!
+ * Reads the state from \a device. Both data written by QToolWindowManager::saveState(QIODevice*)
+ * and a QVariant returned by QToolWindowManager::saveState() and written with QDataStream
+ * are accepted.
+ */
+QToolWindowManagerState QToolWindowManagerState::fromDevice(QIODevice *device)
+{
+    QToolWindowManagerState result;
+    QToolWindowManagerStatePrivate *d = result.d.data();
+    if (!device || !device->isReadable()) {
+        d->errorString = QLatin1String("device is not readable");
+        return result;
+    }
+    d->valid = QToolWindowManagerStatePrivate::read(device, d->data, &d->errorString) &&
+               QToolWindowManagerStatePrivate::validate(d->data, &d->errorString);
+    return result;
+}
+
+/*! Returns true if the state has been parsed successfully and can be restored. */
+bool QToolWindowManagerState::isValid() const
+{
+    return d->valid;
+}
+
+/*! Returns a description of the reason why the state is invalid. */
+QString QToolWindowManagerState::errorString() const
+{
+    return d->errorString;
+}
+
+static void collectNames(const QToolWindowManagerStateNode &node, QStringList &names)
+{
+    names << node.objectNames;
+    foreach (const QToolWindowManagerStateNode &item, node.items)
+        collectNames(item, names);
+}
+
+/*! Returns object names of tool windows that are visible in the layout. */
+QStringList QToolWindowManagerState::toolWindowNames() const
+{
+    QStringList names;
+    collectNames(d->data.mainWrapper.root, names);
+    foreach (const QToolWindowManagerStateWindow &window, d->data.floatingWindows)
+        collectNames(window.root, names);
+    return names;
+}
+
+// format 1
+
+static bool parseNodeStateV1(const QVariantMap &data, QToolWindowManagerStateNode &node,
+                             QString *error)
+{
+    QString type = data[QLatin1String("type")].toString();
+    if (type == QLatin1String("area")) {
+        node.type = QToolWindowManagerStateNode::Area;
+        node.objectNames = data[QLatin1String("objectNames")].toStringList();
+        node.customData = data[QLatin1String("customData")];
+        return true;
+    }
+    if (type != QLatin1String("splitter")) {
+        *error = QLatin1String("unknown item type");
+        return false;
+    }
+    node.type = QToolWindowManagerStateNode::Splitter;
+    // the data of QSplitter::saveState: magic, version, sizes, childrenCollapsible,
+    // handleWidth, opaqueResize, orientation
+    QByteArray splitterState = data[QLatin1String("state")].toByteArray();
+    QDataStream stream(&splitterState, QIODevice::ReadOnly);
+    qint32 marker, version, handleWidth, orientation;
+    bool childrenCollapsible, opaqueResize;
+    QList<int> sizes;
+    stream >> marker >> version >> sizes >> childrenCollapsible >> handleWidth >> opaqueResize
+           >> orientation;
+    if (stream.status() != QDataStream::Ok || marker != 0xff ||
+            (orientation != Qt::Horizontal && orientation != Qt::Vertical)) {
+        *error = QLatin1String("invalid splitter state");
+        return false;
+    }
+    node.sizes = sizes;
+    node.orientation = static_cast<Qt::Orientation>(orientation);
+    foreach (const QVariant &itemData, data[QLatin1String("items")].toList()) {
+        node.items << QToolWindowManagerStateNode();
+        if (!parseNodeStateV1(itemData.toMap(), node.items.last(), error))
+            return false;
+    }
+    return true;
+}
+
+static bool parseWindowStateV1(const QVariantMap &data, QToolWindowManagerStateWindow &window,
+                               QString *error)
+{
+    window.geometry = data[QLatin1String("geometry")].toByteArray();
+    if (data.contains(QLatin1String("splitter")))
+        return parseNodeStateV1(data[QLatin1String("splitter")].toMap(), window.root, error);
+    if (data.contains(QLatin1String("area")))
+        return parseNodeStateV1(data[QLatin1String("area")].toMap(), window.root, error);
+    return true;
+}
+
+bool QToolWindowManagerStatePrivate::parse(const QVariantMap &variant,
+                                           QToolWindowManagerStateData &state, QString *error)
+{
+    if (variant[QLatin1String("QToolWindowManagerStateFormat")].toInt() != 1) {
+        *error = QLatin1String("state format is not recognized");
+        return false;
+    }
+    if (!parseWindowStateV1(variant[QLatin1String("mainWrapper")].toMap(), state.mainWrapper, error))
+        return false;
+    foreach (const QVariant &windowData, variant[QLatin1String("floatingWindows")].toList()) {
+        state.floatingWindows << QToolWindowManagerStateWindow();
+        if (!parseWindowStateV1(windowData.toMap(), state.floatingWindows.last(), error))
+            return false;
+    }
+    return true;
+}
+
+// format 2
+//
+// header: quint32 magic, quint32 format, quint32 payload size, quint16 payload checksum
+// payload: QStringList name table, main wrapper, quint32 count, floating wrappers
+// wrapper: QByteArray geometry, node
+// node: quint8 type, then
+//   area: quint32 count, quint32 name indices, QVariant custom data
+//   splitter: quint8 orientation, quint32 count, qint32 sizes, child nodes
+
+static const quint32 stateMagic = 0x5154574d; // "QTWM"
+static const quint32 stateFormat = 2;
+static const QDataStream::Version stateStreamVersion = QDataStream::Qt_4_6;
+// limits applied while reading, so that corrupt or hostile data can't exhaust memory or the stack
+static const quint32 maxStatePayloadSize = 64 * 1024 * 1024;
+static const int maxStateNodeDepth = 64;
+
+namespace {
+
+class StateWriter
+{
+public:
+    explicit StateWriter(QByteArray *data) : stream(data, QIODevice::WriteOnly)
+    {
+        stream.setVersion(stateStreamVersion);
+    }
+
+    void writeWindow(const QToolWindowManagerStateWindow &window)
+    {
+        stream << window.geometry;
+        writeNode(window.root);
+    }
+
+    void writeNode(const QToolWindowManagerStateNode &node)
+    {
+        stream << quint8(node.type);
+        switch (node.type) {
+        case QToolWindowManagerStateNode::Area:
+            stream << quint32(node.objectNames.count());
+            foreach (const QString &name, node.objectNames)
+                stream << intern(name);
+            stream << node.customData;
+            break;
+        case QToolWindowManagerStateNode::Splitter:
+            stream << quint8(node.orientation) << quint32(node.items.count());
+            for (int i = 0; i < node.items.count(); i++)
+                stream << qint32(node.sizes.value(i));
+            foreach (const QToolWindowManagerStateNode &item, node.items)
+                writeNode(item);
+            break;
+        default:
+            break;
+        }
+    }
+
+    QDataStream stream;
+    QStringList names;
+
+private:
+    quint32 intern(const QString &name)
+    {
+        QHash<QString, quint32>::const_iterator it = m_indices.constFind(name);
+        if (it != m_indices.constEnd())
+            return it.value();
+        quint32 index = names.count();
+        names << name;
+        m_indices.insert(name, index);
+        return index;
+    }
+
+    QHash<QString, quint32> m_indices;
+};
+
+class StateReader
+{
+public:
+    explicit StateReader(const QByteArray &data) : stream(data)
+    {
+        stream.setVersion(stateStreamVersion);
+    }
+
+    bool readNames()
+    {
+        quint32 count;
+        stream >> count;
+        // each string takes at least its quint32 length
+        if (stream.status() != QDataStream::Ok || !fits(count, sizeof(quint32)))
+            return false;
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+            QString name;
+            stream >> name;
+            names << name;
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool readWindow(QToolWindowManagerStateWindow &window)
+    {
+        stream >> window.geometry;
+        return readNode(window.root, 0);
+    }
+
+    // returns true if \a count items of at least \a itemSize bytes each may follow
+    bool fits(quint32 count, int itemSize) const
+    {
+        return qint64(count) * itemSize <= stream.device()->bytesAvailable();
+    }
+
+    bool readNode(QToolWindowManagerStateNode &node, int depth)
+    {
+        if (depth > maxStateNodeDepth)
+            return false;
+        quint8 type;
+        stream >> type;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+        switch (type) {
+        case QToolWindowManagerStateNode::Empty:
+            node.type = QToolWindowManagerStateNode::Empty;
+            return true;
+        case QToolWindowManagerStateNode::Area: {
+            node.type = QToolWindowManagerStateNode::Area;
+            quint32 count;
+            stream >> count;
+            if (!fits(count, sizeof(quint32)))
+                return false;
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+                quint32 index;
+                stream >> index;
+                if (index >= quint32(names.count()))
+                    return false;
+                node.objectNames << names[index];
+            }
+            stream >> node.customData;
+            return stream.status() == QDataStream::Ok;
+        }
+        case QToolWindowManagerStateNode::Splitter: {
+            node.type = QToolWindowManagerStateNode::Splitter;
+            quint8 orientation;
+            quint32 count;
+            stream >> orientation >> count;
+            if (orientation != Qt::Horizontal && orientation != Qt::Vertical)
+                return false;
+            // each item takes its qint32 size and at least the quint8 type of its node
+            if (!fits(count, sizeof(qint32) + sizeof(quint8)))
+                return false;
+            node.orientation = static_cast<Qt::Orientation>(orientation);
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+                qint32 size;
+                stream >> size;
+                node.sizes << size;
+            }
+            for (quint32 i = 0; i < count; i++) {
+                node.items << QToolWindowManagerStateNode();
+                if (!readNode(node.items.last(), depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    QDataStream stream;
+    QStringList names;
+};
+
+} // namespace
+
+bool QToolWindowManagerStatePrivate::write(QIODevice *device, const QToolWindowManagerStateData &state)
+{
+    // the name table precedes the layout, so the layout is written first
+    QByteArray layoutData;
+    StateWriter writer(&layoutData);
+    writer.writeWindow(state.mainWrapper);
+    writer.stream << quint32(state.floatingWindows.count());
+    foreach (const QToolWindowManagerStateWindow &window, state.floatingWindows)
+        writer.writeWindow(window);
+
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(stateStreamVersion);
+    payloadStream << writer.names;
+    payloadStream.writeRawData(layoutData.constData(), layoutData.size());
+
+    QDataStream stream(device);
+    stream.setVersion(stateStreamVersion);
+    stream << stateMagic << stateFormat << quint32(payload.size())
+           << qChecksum(payload.constData(), payload.size());
+    stream.writeRawData(payload.constData(), payload.size());
+    if (stream.status() != QDataStream::Ok) {
+        qWarning("failed to write state");
+        return false;
+    }
+    return true;
+}
+
+bool QToolWindowManagerStatePrivate::read(QIODevice *device, QToolWindowManagerStateData &state,
+                                          QString *error)
+{
+    QDataStream stream(device);
+    stream.setVersion(stateStreamVersion);
+    QByteArray magic = device->peek(sizeof(quint32));
+    if (magic.size() != sizeof(quint32) || qFromBigEndian<quint32>(
+                reinterpret_cast<const uchar*>(magic.constData())) != stateMagic) {
+        // format 1 written with QDataStream
+        QVariant data;
+        stream >> data;
+        if (stream.status() != QDataStream::Ok) {
+            *error = QLatin1String("state format is not recognized");
+            return false;
+        }
+        return parse(data.toMap(), state, error);
+    }
+    quint32 storedMagic, format, size;
+    quint16 checksum;
+    stream >> storedMagic >> format >> size >> checksum;
+    if (stream.status() != QDataStream::Ok || format != stateFormat) {
+        *error = QLatin1String("state format is not recognized");
+        return false;
+    }
+    // a sequential device may not have received all the data yet
+    if (device->isSequential() ? size > maxStatePayloadSize : size > device->bytesAvailable()) {
+        *error = QLatin1String("state data is corrupt");
+        return false;
+    }
+    QByteArray payload = device->read(size);
+    if (payload.size() != int(size) || qChecksum(payload.constData(), payload.size()) != checksum) {
+        *error = QLatin1String("state data is corrupt");
+        return false;
+    }
+    StateReader reader(payload);
+    quint32 floatingCount = 0;
+    bool ok = reader.readNames() && reader.readWindow(state.mainWrapper);
+    if (ok) {
+        reader.stream >> floatingCount;
+        // each window takes at least its quint32 geometry length and a quint8 node type
+        ok = reader.fits(floatingCount, sizeof(quint32) + sizeof(quint8));
+    }
+    for (quint32 i = 0; ok && i < floatingCount; i++) {
+        state.floatingWindows << QToolWindowManagerStateWindow();
+        ok = reader.readWindow(state.floatingWindows.last());
+    }
+    if (!ok || reader.stream.status() != QDataStream::Ok) {
+        *error = QLatin1String("state data is corrupt");
+        return false;
+    }
+    return true;
+}
+
+static bool validateNode(const QToolWindowManagerStateNode &node, QSet<QString> &names,
+                         QString *error)
+{
+    switch (node.type) {
+    case QToolWindowManagerStateNode::Area:
+        foreach (const QString &name, node.objectNames) {
+            if (names.contains(name)) {
+                *error = QString::fromLatin1("tool window '%1' is placed more than once").arg(name);
+                return false;
+            }
+            names.insert(name);
+        }
+        return true;
+    case QToolWindowManagerStateNode::Splitter:
+        if (node.items.isEmpty()) {
+            *error = QLatin1String("invalid splitter encountered");
+            return false;
+        }
+        foreach (const QToolWindowManagerStateNode &item, node.items) {
+            if (item.type == QToolWindowManagerStateNode::Empty) {
+                *error = QLatin1String("unknown item type");
+                return false;
+            }
+            if (!validateNode(item, names, error))
+                return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+bool QToolWindowManagerStatePrivate::validate(const QToolWindowManagerStateData &state, QString *error)
+{
+    QSet<QString> names;
+    if (!validateNode(state.mainWrapper.root, names, error))
+        return false;
+    foreach (const QToolWindowManagerStateWindow &window, state.floatingWindows) {
+        if (!validateNode(window.root, names, error))
+            return false;
+    }
+    return true;
+}
+
+#endif // QT_NO_TOOLWINDOWMANAGER
+
+QT_END_NAMESPACE
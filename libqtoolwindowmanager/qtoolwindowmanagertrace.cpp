@@ -0,0 +1,123 @@
+/****************************************************************************
+**
+** Copyright (C) 2014 Pavel Strakhov <ri@idzaaus.org>
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy
+** of this software and associated documentation files (the "Software"), to deal
+** in the Software without restriction, including without limitation the rights
+** to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+** copies of the Software, and to permit persons to whom the Software is
+** furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+** OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+** SOFTWARE.
+**
+** Copyright (C) 2014 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtWidgets module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qtoolwindowmanagertrace_p.h>
+#include <qcoreapplication.h>
+#include <qiodevice.h>
+#include <qtextstream.h>
+
+QT_BEGIN_NAMESPACE
+
+#ifndef QT_NO_TOOLWINDOWMANAGER
+
+#if QT_VERSION >= 0x050400
+Q_LOGGING_CATEGORY(lcToolWindowManagerTrace, "qt.toolwindowmanager.trace", QtWarningMsg)
+#else
+bool qt_toolwindowmanager_trace_enabled = !qgetenv("QT_TOOLWINDOWMANAGER_TRACE").isEmpty();
+#endif
+
+QToolWindowManagerTrace::QToolWindowManagerTrace() :
+    m_depth(0)
+{
+    m_clock.start();
+}
+
+void QToolWindowManagerTrace::end(const char *name, qint64 start, int widgetCount)
+{
+    m_depth--;
+    if (m_events.count() >= MaxEvents)
+        m_events.remove(0, MaxEvents / 2);
+    Event event;
+    event.name = name;
+    event.start = start;
+    event.duration = now() - start;
+    event.depth = m_depth;
+    event.widgetCount = widgetCount;
+    m_events.append(event);
+}
+
+bool QToolWindowManagerTrace::write(QIODevice *device) const
+{
+    QTextStream stream(device);
+    stream << "{\"traceEvents\":[";
+    qint64 pid = QCoreApplication::applicationPid();
+    for (int i = 0; i < m_events.count(); i++) {
+        const Event &event = m_events[i];
+        if (i > 0)
+            stream << ',';
+        // timestamps are in microseconds
+        stream << "\n{\"name\":\"" << event.name << "\",\"cat\":\"QToolWindowManager\",\"ph\":\"X\""
+               << ",\"ts\":" << event.start / 1000 << '.' << qSetFieldWidth(3) << qSetPadChar('0')
+               << event.start % 1000 << qSetFieldWidth(0)
+               << ",\"dur\":" << event.duration / 1000 << '.' << qSetFieldWidth(3)
+               << event.duration % 1000 << qSetFieldWidth(0)
+               << ",\"pid\":" << pid << ",\"tid\":0"
+               << ",\"args\":{\"widgets\":" << event.widgetCount
+               << ",\"depth\":" << event.depth << "}}";
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
+
+#endif // QT_NO_TOOLWINDOWMANAGER
+
+QT_END_NAMESPACE
@@ -84,12 +84,15 @@ QToolWindowManagerWrapper::QToolWindowManagerWrapper(QToolWindowManager *manager
     mainLayout->setContentsMargins(0, 0, 0, 0);
     QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
     manager_d->m_wrappers << this;
+    manager_d->invalidateDropTargets();
 }
 
 QToolWindowManagerWrapper::~QToolWindowManagerWrapper()
 {
     QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
     manager_d->m_wrappers.removeOne(this);
+    manager_d->m_exposureChangedWidgetsSet.remove(this);
+    manager_d->invalidateDropTargets();
 }
 
 void QToolWindowManagerWrapper::closeEvent(QCloseEvent *)
@@ -100,6 +103,52 @@ void QToolWindowManagerWrapper::closeEvent(QCloseEvent *)
     m_manager->moveToolWindows(toolWindows, QToolWindowManager::NoArea);
 }
 
+void QToolWindowManagerWrapper::resizeEvent(QResizeEvent *event)
+{
+    QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
+    manager_d->invalidateDropTargets();
+    if (isWindow())
+        manager_d->scheduleAutoSave();
+    if (isVisible() && !manager_d->m_pendingSplitterSizes.isEmpty())
+        manager_d->applySplitterSizes();
+    QWidget::resizeEvent(event);
+}
+
+void QToolWindowManagerWrapper::moveEvent(QMoveEvent *event)
+{
+    if (isWindow()) {
+        QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
+        manager_d->invalidateDropWrapperGeometry();
+        manager_d->scheduleAutoSave();
+    }
+    QWidget::moveEvent(event);
+}
+
+void QToolWindowManagerWrapper::showEvent(QShowEvent *event)
+{
+    QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
+    manager_d->scheduleExposureUpdate(this);
+    // the wrapper has its real size now
+    if (!manager_d->m_pendingSplitterSizes.isEmpty())
+        manager_d->applySplitterSizes();
+    QWidget::showEvent(event);
+}
+
+void QToolWindowManagerWrapper::hideEvent(QHideEvent *event)
+{
+    m_manager->d_func()->scheduleExposureUpdate(this);
+    QWidget::hideEvent(event);
+}
+
+void QToolWindowManagerWrapper::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange)
+        m_manager->d_func()->scheduleExposureUpdate(this);
+    if (event->type() == QEvent::ActivationChange && isWindow() && isActiveWindow())
+        m_manager->d_func()->topLevelActivated(this);
+    QWidget::changeEvent(event);
+}
+
 QVariantMap QToolWindowManagerWrapper::saveState() const
 {
     if (layout()->count() > 1) {
@@ -128,21 +177,25 @@ QVariantMap QToolWindowManagerWrapper::saveState() const
     return result;
 }
 
-void QToolWindowManagerWrapper::restoreState(const QVariantMap &data)
+void QToolWindowManagerWrapper::restoreState(const QToolWindowManagerStateWindow &data)
 {
-    restoreGeometry(data[QLatin1String("geometry")].toByteArray());
-    if (layout()->count() > 0) {
-        qWarning("wrapper is not empty");
-        return;
-    }
+    restoreGeometry(data.geometry);
     QToolWindowManagerPrivate * const manager_d = m_manager->d_func();
-    if (data.contains(QLatin1String("splitter"))) {
-        layout()->addWidget(manager_d->restoreSplitterState(data[QLatin1String("splitter")].toMap()));
-    } else if (data.contains(QLatin1String("area"))) {
-        layout()->addWidget(manager_d->restoreAreaState(data[QLatin1String("area")].toMap()));
+    QWidget *previousContent = content();
+    QWidget *newContent = manager_d->restoreNodeState(data.root, previousContent);
+    // previous content is removed by the manager if it hasn't been reused
+    if (newContent && newContent != previousContent) {
+        layout()->addWidget(newContent);
+        newContent->show();
     }
 }
 
+QWidget *QToolWindowManagerWrapper::content() const
+{
+    QLayoutItem *item = layout()->itemAt(0);
+    return item ? item->widget() : 0;
+}
+
 #endif // QT_NO_TOOLWINDOWMANAGER
 
 QT_END_NAMESPACE